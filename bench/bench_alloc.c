@@ -0,0 +1,576 @@
+#include <stdio.h>
+#include <string.h>
+#include <threads.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+#include "common.h"
+#include "arena.h"
+#include "pool_allocator.h"
+#include "concurrent_pool.h"
+#include "tlsf.h"
+
+// Allocator benchmarks. Prints a single JSON array on stdout, one object per
+// result with at least name/allocator/pattern/rss_kib. The concurrent pool's
+// correctness check is test/test_concurrent_pool.c.
+
+enum { ELEM_SIZE = 64 };
+enum { ELEM_ALIGN = 16 };
+enum { ROUND_ELEMS = 256 };
+enum { ROUNDS = 20000 };
+enum { MAX_THREADS = 16 };
+
+static u64 now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (u64)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static u32 xorshift32(u32 *state) {
+    u32 x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return *state = x;
+}
+
+// resident set right now, 0 when /proc is not there
+static u64 rss_kib(void) {
+    FILE *const statm = fopen("/proc/self/statm", "r");
+    if (!statm) {
+        return 0;
+    }
+    unsigned long long size, resident;
+    const int read_cnt = fscanf(statm, "%llu %llu", &size, &resident);
+    fclose(statm);
+    return read_cnt == 2 ? resident * (u64)sysconf(_SC_PAGESIZE) / 1024 : 0;
+}
+
+static u64 peak_rss_kib(void) {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+}
+
+// -- json output --
+
+static bool json_first = true;
+
+static void json_begin(const char *name, const char *allocator, const char *pattern) {
+    printf("%s  {\"name\": \"%s\", \"allocator\": \"%s\", \"pattern\": \"%s\"", json_first ? "" : ",\n", name, allocator, pattern);
+    json_first = false;
+}
+
+static void json_u64(const char *key, u64 val) {
+    printf(", \"%s\": %llu", key, (unsigned long long)val);
+}
+
+static void json_i64(const char *key, i64 val) {
+    printf(", \"%s\": %lld", key, (long long)val);
+}
+
+static void json_f64(const char *key, f64 val) {
+    printf(", \"%s\": %.3f", key, val);
+}
+
+static void json_str(const char *key, const char *val) {
+    printf(", \"%s\": \"%s\"", key, val);
+}
+
+static void json_end(void) {
+    json_u64("rss_kib", rss_kib());
+    printf("}");
+    fflush(stdout);
+}
+
+static void report(const char *allocator, const char *pattern, u32 threads, u64 ops, u64 ns) {
+    char name[96];
+    snprintf(name, sizeof(name), "%s/%s/%u", allocator, pattern, threads);
+    json_begin(name, allocator, pattern);
+    json_u64("threads", threads);
+    json_u64("ops", ops);
+    json_f64("ns_per_op", (f64)ns * threads / ops);
+    json_f64("mops_per_s", (f64)ops * 1000 / ns);
+    json_end();
+}
+
+// -- malloc behind AllocatorPoly so every pattern runs against it unchanged --
+
+static void* malloc_alloc_opaque(void *ctx, size_t size, size_t alignment) {
+    UNUSED(ctx);
+    MY_ASSERT(alignment <= alignof(max_align_t));
+    return malloc(size);
+}
+
+static void* malloc_realloc_opaque(void *ctx, void *old_mem, size_t old_size, size_t new_size, size_t alignment) {
+    UNUSED(ctx);
+    UNUSED(old_size);
+    MY_ASSERT(alignment <= alignof(max_align_t));
+    return realloc(old_mem, new_size);
+}
+
+static void malloc_free_opaque(void *ctx, void *mem, size_t size) {
+    UNUSED(ctx);
+    UNUSED(size);
+    free(mem);
+}
+
+static void malloc_clear_opaque(void *ctx) {
+    UNUSED(ctx);
+}
+
+#define MALLOC_VTABLE { .alloc = malloc_alloc_opaque,\
+                        .realloc = malloc_realloc_opaque,\
+                        .free = malloc_free_opaque,\
+                        .clear = malloc_clear_opaque }
+#define MALLOC_POLY { .vtable = MALLOC_VTABLE, .ctx = NULL }
+
+typedef struct BenchTarget {
+    const char *name;
+    AllocatorPoly poly;
+    bool has_free;
+    bool has_realloc;
+    // clear releases everything at once, bump uses it instead of frees
+    bool has_clear;
+} BenchTarget;
+
+// -- single threaded patterns through allocator_poly --
+
+static void *pattern_ptrs[ROUND_ELEMS];
+
+static void pattern_bump(const BenchTarget *target) {
+    const u64 start = now_ns();
+    for (u32 r=0; r<ROUNDS; r++) {
+        for (u32 i=0; i<ROUND_ELEMS; i++) {
+            pattern_ptrs[i] = allocator_poly_alloc(target->poly, ELEM_SIZE, ELEM_ALIGN);
+            *(volatile u8*)pattern_ptrs[i] = 1;
+        }
+        if (target->has_clear) {
+            allocator_poly_clear(target->poly);
+        } else {
+            for (u32 i=0; i<ROUND_ELEMS; i++) {
+                allocator_poly_free(target->poly, pattern_ptrs[i], ELEM_SIZE);
+            }
+        }
+    }
+    const u64 ops = (u64)ROUNDS * ROUND_ELEMS * (target->has_clear ? 1 : 2);
+    report(target->name, "bump", 1, ops, now_ns() - start);
+}
+
+static void pattern_lifo(const BenchTarget *target) {
+    const u64 start = now_ns();
+    for (u32 r=0; r<ROUNDS; r++) {
+        for (u32 i=0; i<ROUND_ELEMS; i++) {
+            pattern_ptrs[i] = allocator_poly_alloc(target->poly, ELEM_SIZE, ELEM_ALIGN);
+            *(volatile u8*)pattern_ptrs[i] = 1;
+        }
+        for (u32 i=ROUND_ELEMS; i>0; i--) {
+            allocator_poly_free(target->poly, pattern_ptrs[i-1], ELEM_SIZE);
+        }
+    }
+    report(target->name, "lifo", 1, (u64)ROUNDS * ROUND_ELEMS * 2, now_ns() - start);
+    allocator_poly_clear(target->poly);
+}
+
+static void pattern_random_free(const BenchTarget *target) {
+    // shuffled up front so the rng stays out of the timed loop
+    static u32 order[ROUND_ELEMS];
+    u32 rng = 0x2545f491;
+    for (u32 i=0; i<ROUND_ELEMS; i++) {
+        order[i] = i;
+    }
+    for (u32 i=ROUND_ELEMS-1; i>0; i--) {
+        const u32 j = xorshift32(&rng) % (i + 1);
+        const u32 tmp = order[i];
+        order[i] = order[j];
+        order[j] = tmp;
+    }
+    const u64 start = now_ns();
+    for (u32 r=0; r<ROUNDS; r++) {
+        for (u32 i=0; i<ROUND_ELEMS; i++) {
+            pattern_ptrs[i] = allocator_poly_alloc(target->poly, ELEM_SIZE, ELEM_ALIGN);
+            *(volatile u8*)pattern_ptrs[i] = 1;
+        }
+        for (u32 i=0; i<ROUND_ELEMS; i++) {
+            allocator_poly_free(target->poly, pattern_ptrs[order[i]], ELEM_SIZE);
+        }
+    }
+    report(target->name, "random_free", 1, (u64)ROUNDS * ROUND_ELEMS * 2, now_ns() - start);
+    allocator_poly_clear(target->poly);
+}
+
+enum { REALLOC_STEP = 64 };
+enum { REALLOC_MAX = 256 * 1024 };
+enum { REALLOC_ROUNDS = 200 };
+
+static void pattern_realloc_growth(const BenchTarget *target) {
+    const u64 start = now_ns();
+    for (u32 r=0; r<REALLOC_ROUNDS; r++) {
+        u8 *buf = NULL;
+        size_t size = 0;
+        for (; size < REALLOC_MAX; size += REALLOC_STEP) {
+            buf = allocator_poly_realloc(target->poly, buf, size, size + REALLOC_STEP, ELEM_ALIGN);
+            buf[size] = 1;
+        }
+        if (target->has_clear) {
+            allocator_poly_clear(target->poly);
+        } else {
+            allocator_poly_free(target->poly, buf, size);
+        }
+    }
+    report(target->name, "realloc_growth", 1, (u64)REALLOC_ROUNDS * (REALLOC_MAX / REALLOC_STEP), now_ns() - start);
+}
+
+// -- same patterns with direct calls, the gap to the poly numbers is the dispatch --
+
+static void bench_arena_direct(Arena *arena) {
+    const u64 start = now_ns();
+    for (u32 r=0; r<ROUNDS; r++) {
+        for (u32 i=0; i<ROUND_ELEMS; i++) {
+            pattern_ptrs[i] = arena_alloc(arena, ELEM_SIZE, ELEM_ALIGN);
+            *(volatile u8*)pattern_ptrs[i] = 1;
+        }
+        arena_clear(arena);
+    }
+    report("arena_direct", "bump", 1, (u64)ROUNDS * ROUND_ELEMS, now_ns() - start);
+
+    const u64 realloc_start = now_ns();
+    for (u32 r=0; r<REALLOC_ROUNDS; r++) {
+        u8 *buf = NULL;
+        for (size_t size = 0; size < REALLOC_MAX; size += REALLOC_STEP) {
+            buf = arena_realloc(arena, buf, size, size + REALLOC_STEP, ELEM_ALIGN);
+            buf[size] = 1;
+        }
+        arena_clear(arena);
+    }
+    report("arena_direct", "realloc_growth", 1, (u64)REALLOC_ROUNDS * (REALLOC_MAX / REALLOC_STEP), now_ns() - realloc_start);
+}
+
+static void bench_pool_direct(PoolAllocator *pool) {
+    const u64 start = now_ns();
+    for (u32 r=0; r<ROUNDS; r++) {
+        for (u32 i=0; i<ROUND_ELEMS; i++) {
+            pattern_ptrs[i] = pool_allocator_alloc(pool);
+            *(volatile u8*)pattern_ptrs[i] = 1;
+        }
+        for (u32 i=0; i<ROUND_ELEMS; i++) {
+            pool_allocator_free(pool, pattern_ptrs[i]);
+        }
+    }
+    report("pool_direct", "fifo", 1, (u64)ROUNDS * ROUND_ELEMS * 2, now_ns() - start);
+}
+
+enum { PATTERN_TLSF_REGION = 64 * 1024 * 1024 };
+
+static void bench_patterns(void) {
+    Arena arena;
+    Arena pool_backing;
+    Arena tlsf_backing;
+    if (!arena_init_virtual(&arena, (size_t)1 << 30, ARENA_FLAG_NONE)) {
+        return;
+    }
+    if (!arena_init_virtual(&pool_backing, (size_t)1 << 30, ARENA_FLAG_NONE)) {
+        arena_release(&arena);
+        return;
+    }
+    if (!arena_init_virtual(&tlsf_backing, PATTERN_TLSF_REGION, ARENA_FLAG_NONE)) {
+        arena_release(&pool_backing);
+        arena_release(&arena);
+        return;
+    }
+    PoolAllocator pool;
+    pool_allocator_init(&pool, (AllocatorPoly)ARENA_POLY(&pool_backing), ELEM_SIZE, ELEM_ALIGN, 1024);
+    static Tlsf tlsf;
+    u8 *const tlsf_region = ARENA_MAKE(&tlsf_backing, u8, PATTERN_TLSF_REGION);
+    const bool tlsf_ok = tlsf_region && tlsf_init(&tlsf, tlsf_region, PATTERN_TLSF_REGION);
+
+    const BenchTarget targets[] = {
+        { .name = "malloc", .poly = MALLOC_POLY, .has_free = true, .has_realloc = true },
+        { .name = "arena", .poly = ARENA_POLY(&arena), .has_realloc = true, .has_clear = true },
+        { .name = "pool", .poly = POOL_ALLOCATOR_POLY(&pool), .has_free = true },
+        { .name = "tlsf", .poly = TLSF_POLY(&tlsf), .has_free = true, .has_realloc = true, .has_clear = true },
+    };
+    for (u32 i=0; i<(u32)ARRAY_LEN(targets); i++) {
+        const BenchTarget *const target = &targets[i];
+        if (target->poly.ctx == &tlsf && !tlsf_ok) {
+            continue;
+        }
+        pattern_bump(target);
+        if (target->has_free) {
+            pattern_lifo(target);
+            pattern_random_free(target);
+        }
+        if (target->has_realloc) {
+            pattern_realloc_growth(target);
+        }
+    }
+    bench_arena_direct(&arena);
+    bench_pool_direct(&pool);
+
+    arena_release(&tlsf_backing);
+    arena_release(&pool_backing);
+    arena_release(&arena);
+}
+
+// -- multithreaded: malloc against the concurrent pool --
+
+typedef struct ThroughputJob {
+    ConcurrentPool *pool;
+    u32 rounds;
+    u64 ns;
+} ThroughputJob;
+
+static int malloc_rounds_thread(void *arg) {
+    ThroughputJob *const job = arg;
+    void *ptrs[ROUND_ELEMS];
+    const u64 start = now_ns();
+    for (u32 r=0; r<job->rounds; r++) {
+        for (u32 i=0; i<ROUND_ELEMS; i++) {
+            ptrs[i] = malloc(ELEM_SIZE);
+            *(volatile u8*)ptrs[i] = 1;
+        }
+        for (u32 i=0; i<ROUND_ELEMS; i++) {
+            free(ptrs[i]);
+        }
+    }
+    job->ns = now_ns() - start;
+    return 0;
+}
+
+static int concurrent_pool_rounds_thread(void *arg) {
+    ThroughputJob *const job = arg;
+    ConcurrentPoolCache cache;
+    concurrent_pool_cache_init(&cache, job->pool);
+    void *ptrs[ROUND_ELEMS];
+    const u64 start = now_ns();
+    for (u32 r=0; r<job->rounds; r++) {
+        for (u32 i=0; i<ROUND_ELEMS; i++) {
+            ptrs[i] = concurrent_pool_cache_alloc(&cache);
+            *(volatile u8*)ptrs[i] = 1;
+        }
+        for (u32 i=0; i<ROUND_ELEMS; i++) {
+            concurrent_pool_cache_free(&cache, ptrs[i]);
+        }
+    }
+    job->ns = now_ns() - start;
+    concurrent_pool_cache_flush(&cache);
+    return 0;
+}
+
+static void bench_threads(const char *name, thrd_start_t fn, u32 thread_cnt) {
+    Arena arena;
+    if (!arena_init_virtual(&arena, (size_t)1 << 30, ARENA_FLAG_NONE)) {
+        return;
+    }
+    ConcurrentPool pool;
+    concurrent_pool_init(&pool, (AllocatorPoly)ARENA_POLY(&arena), ELEM_SIZE, ELEM_ALIGN, 32);
+    thrd_t threads[MAX_THREADS];
+    ThroughputJob jobs[MAX_THREADS];
+    for (u32 t=0; t<thread_cnt; t++) {
+        jobs[t] = (ThroughputJob) { .pool = &pool, .rounds = ROUNDS / thread_cnt };
+        thrd_create(&threads[t], fn, &jobs[t]);
+    }
+    u64 ns = 0;
+    for (u32 t=0; t<thread_cnt; t++) {
+        thrd_join(threads[t], NULL);
+        ns = jobs[t].ns > ns ? jobs[t].ns : ns;
+    }
+    report(name, "threaded_lifo", thread_cnt, (u64)(ROUNDS / thread_cnt) * thread_cnt * ROUND_ELEMS * 2, ns);
+    arena_release(&arena);
+}
+
+// -- random sizes and random frees: per-op latency and tlsf fragmentation --
+
+enum { RANDOM_SLOTS = 4096 };
+enum { RANDOM_OPS = 1000000 };
+enum { RANDOM_MAX_ALLOC = 4096 };
+
+static int cmp_u64(const void *a, const void *b) {
+    const u64 x = *(const u64*)a;
+    const u64 y = *(const u64*)b;
+    return (x > y) - (x < y);
+}
+
+static void report_latency(const char *allocator, const char *op, u64 *samples, u32 cnt) {
+    qsort(samples, cnt, sizeof(*samples), cmp_u64);
+    char name[96];
+    snprintf(name, sizeof(name), "%s/random_sizes/%s", allocator, op);
+    json_begin(name, allocator, "random_sizes");
+    json_str("op", op);
+    json_u64("samples", cnt);
+    json_u64("p50_ns", samples[cnt / 2]);
+    json_u64("p99_ns", samples[cnt / 100 * 99]);
+    json_u64("p999_ns", samples[cnt / 1000 * 999]);
+    json_u64("max_ns", samples[cnt - 1]);
+    json_end();
+}
+
+static void bench_random_sizes(const char *allocator, AllocatorPoly poly) {
+    static void *slots[RANDOM_SLOTS];
+    static size_t sizes[RANDOM_SLOTS];
+    static u64 alloc_ns[RANDOM_OPS];
+    static u64 free_ns[RANDOM_OPS];
+    memset(slots, 0, sizeof(slots));
+    u32 alloc_cnt = 0;
+    u32 free_cnt = 0;
+    u32 rng = 0x9e3779b9;
+    for (u32 op=0; op<RANDOM_OPS; op++) {
+        const u32 slot = xorshift32(&rng) % RANDOM_SLOTS;
+        if (slots[slot]) {
+            const u64 start = now_ns();
+            allocator_poly_free(poly, slots[slot], sizes[slot]);
+            free_ns[free_cnt++] = now_ns() - start;
+            slots[slot] = NULL;
+        } else {
+            sizes[slot] = 16 + xorshift32(&rng) % RANDOM_MAX_ALLOC;
+            const u64 start = now_ns();
+            slots[slot] = allocator_poly_alloc(poly, sizes[slot], ELEM_ALIGN);
+            alloc_ns[alloc_cnt++] = now_ns() - start;
+            if (slots[slot]) {
+                *(volatile u8*)slots[slot] = 1;
+            }
+        }
+    }
+    report_latency(allocator, "alloc", alloc_ns, alloc_cnt);
+    report_latency(allocator, "free", free_ns, free_cnt);
+    for (u32 slot=0; slot<RANDOM_SLOTS; slot++) {
+        if (slots[slot]) {
+            allocator_poly_free(poly, slots[slot], sizes[slot]);
+        }
+    }
+}
+
+static void bench_tlsf(void) {
+    enum { TLSF_REGION_SIZE = RANDOM_SLOTS * RANDOM_MAX_ALLOC * 2 };
+    Arena arena;
+    if (!arena_init_virtual(&arena, TLSF_REGION_SIZE, ARENA_FLAG_NONE)) {
+        return;
+    }
+    u8 *const region = ARENA_MAKE(&arena, u8, TLSF_REGION_SIZE);
+    static Tlsf tlsf;
+    if (!region || !tlsf_init(&tlsf, region, TLSF_REGION_SIZE)) {
+        arena_release(&arena);
+        return;
+    }
+    bench_random_sizes("malloc", (AllocatorPoly)MALLOC_POLY);
+    bench_random_sizes("tlsf", (AllocatorPoly)TLSF_POLY(&tlsf));
+
+    // steady state with about half the slots live and sizes all over the place
+    static void *slots[RANDOM_SLOTS];
+    memset(slots, 0, sizeof(slots));
+    u32 rng = 0x12345678;
+    for (u32 op=0; op<RANDOM_OPS; op++) {
+        const u32 slot = xorshift32(&rng) % RANDOM_SLOTS;
+        if (slots[slot]) {
+            tlsf_free(&tlsf, slots[slot]);
+            slots[slot] = NULL;
+        } else {
+            slots[slot] = tlsf_alloc(&tlsf, 16 + xorshift32(&rng) % RANDOM_MAX_ALLOC, ELEM_ALIGN);
+        }
+    }
+    TlsfStats stats;
+    tlsf_get_stats(&tlsf, &stats);
+    json_begin("tlsf/fragmentation", "tlsf", "fragmentation");
+    json_u64("used_bytes", stats.used_bytes);
+    json_u64("free_bytes", stats.free_bytes);
+    json_u64("used_blocks", stats.used_blocks);
+    json_u64("free_blocks", stats.free_blocks);
+    json_u64("largest_free_block", stats.largest_free_block);
+    json_f64("fragmentation_pct", stats.free_bytes ? 100.0 * (1.0 - (f64)stats.largest_free_block / stats.free_bytes) : 0.0);
+    json_end();
+    arena_release(&arena);
+}
+
+// -- huge pages: random touches over a large arena, throughput and dTLB misses --
+
+enum { TLB_REGION_SIZE = 512 * 1024 * 1024 };
+enum { TLB_ACCESSES = 20000000 };
+
+// -1 when perf events are not available (no permission, VM without PMU, ...)
+static int open_dtlb_miss_counter(void) {
+    struct perf_event_attr attr = {
+        .type = PERF_TYPE_HW_CACHE,
+        .size = sizeof(attr),
+        .config = PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16),
+        .disabled = 1,
+        .exclude_kernel = 1,
+        .exclude_hv = 1,
+    };
+    return syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+static const char* page_kind_name(ArenaPageKind kind) {
+    switch (kind) {
+        case ARENA_PAGE_KIND_DEFAULT: return "default";
+        case ARENA_PAGE_KIND_TRANSPARENT_HUGE: return "thp";
+        case ARENA_PAGE_KIND_HUGETLB: return "hugetlb";
+    }
+    return "?";
+}
+
+static void bench_tlb(u32 flags) {
+    Arena arena;
+    if (!arena_init_virtual(&arena, TLB_REGION_SIZE, flags)) {
+        return;
+    }
+    u64 *const region = ARENA_MAKE(&arena, u64, TLB_REGION_SIZE / sizeof(u64));
+    if (!region) {
+        arena_release(&arena);
+        return;
+    }
+    memset(region, 0, TLB_REGION_SIZE);
+    const int perf_fd = open_dtlb_miss_counter();
+    if (perf_fd >= 0) {
+        ioctl(perf_fd, PERF_EVENT_IOC_RESET, 0);
+        ioctl(perf_fd, PERF_EVENT_IOC_ENABLE, 0);
+    }
+    u32 rng = 0xdeadbeef;
+    const u64 start = now_ns();
+    for (u32 i=0; i<TLB_ACCESSES; i++) {
+        region[xorshift32(&rng) % (TLB_REGION_SIZE / sizeof(u64))]++;
+    }
+    const u64 ns = now_ns() - start;
+    long long misses = -1;
+    if (perf_fd >= 0) {
+        ioctl(perf_fd, PERF_EVENT_IOC_DISABLE, 0);
+        if (read(perf_fd, &misses, sizeof(misses)) != sizeof(misses)) {
+            misses = -1;
+        }
+        close(perf_fd);
+    }
+    const char *const kind = page_kind_name(arena.page_kind);
+    char name[64];
+    snprintf(name, sizeof(name), "arena_%s/random_touch/1", kind);
+    json_begin(name, "arena", "random_touch");
+    json_str("page_kind", kind);
+    json_u64("page_size", arena.page_size);
+    json_u64("ops", TLB_ACCESSES);
+    json_f64("ns_per_op", (f64)ns / TLB_ACCESSES);
+    json_f64("mops_per_s", (f64)TLB_ACCESSES * 1000 / ns);
+    json_i64("dtlb_read_misses", misses);
+    json_end();
+    arena_release(&arena);
+}
+
+int main(int argc, char **argv) {
+    UNUSED(argc);
+    UNUSED(argv);
+    printf("[\n");
+    bench_patterns();
+    for (u32 thread_cnt = 1; thread_cnt <= 8; thread_cnt *= 2) {
+        bench_threads("malloc", malloc_rounds_thread, thread_cnt);
+        bench_threads("concurrent_pool", concurrent_pool_rounds_thread, thread_cnt);
+    }
+    bench_tlsf();
+    bench_tlb(ARENA_FLAG_NONE);
+    bench_tlb(ARENA_FLAG_HUGE_PAGES);
+    json_begin("process", "process", "summary");
+    json_u64("peak_rss_kib", peak_rss_kib());
+    json_end();
+    printf("\n]\n");
+    return 0;
+}
@@ -0,0 +1,78 @@
+#ifndef alloc_stats_h_INCLUDED
+#define alloc_stats_h_INCLUDED
+
+#include "common.h"
+#include "arena.h"
+#include "poly_allocator.h"
+
+// AllocatorPoly wrapper that counts what goes through it.
+// Histogram bucket i holds allocations of size in [2^(i-1), 2^i).
+
+typedef enum AllocStatsFlags {
+    ALLOC_STATS_FLAG_NONE = 0,
+    // the inner allocator only gives memory back on clear (arenas, stacks):
+    // frees are counted but keep their bytes live, a moving realloc keeps the old block
+    ALLOC_STATS_FLAG_NO_FREE = 1 << 0,
+} AllocStatsFlags;
+
+enum { ALLOC_STATS_HISTOGRAM_BUCKETS = 32 };
+
+typedef struct AllocStatsCallSite {
+    const char *file;
+    u32 line;
+    u32 alloc_cnt;
+    size_t bytes;
+} AllocStatsCallSite;
+
+typedef struct AllocStats {
+    AllocatorPoly inner;
+    const char *name;
+    u32 flags;
+    size_t bytes_live;
+    size_t high_water;
+    u64 alloc_cnt;
+    u64 free_cnt;
+    u64 histogram[ALLOC_STATS_HISTOGRAM_BUCKETS];
+    // from alloc_stats_sample_arena, includes what bypassed the wrapper
+    const Arena *sampled_arena;
+    size_t arena_offset;
+
+    u64 frame_alloc_cnt;
+    size_t frame_alloc_bytes;
+    bool in_frame;
+    // an allocation or a realloc that grows the live bytes between
+    // begin_frame and end_frame trips an assert, shrinks do not
+    bool assert_no_frame_growth;
+
+    // open addressing table keyed by (file, line), NULL when call sites are off
+    AllocStatsCallSite *call_sites;
+    u32 call_sites_cap;
+    u32 call_sites_dropped;
+} AllocStats;
+
+void alloc_stats_init(AllocStats *stats, const char *name, AllocatorPoly inner, u32 flags);
+// call_sites_cap must be a power of two
+void alloc_stats_enable_call_sites(AllocStats *stats, AllocStatsCallSite *call_sites, u32 call_sites_cap);
+void alloc_stats_begin_frame(AllocStats *stats);
+void alloc_stats_end_frame(AllocStats *stats);
+// records the arena behind inner, the report then shows its usage next to
+// what went through the wrapper
+void alloc_stats_sample_arena(AllocStats *stats, const Arena *arena);
+void alloc_stats_report(const AllocStats *stats);
+
+// attributes the next traced allocation on this thread to file:line
+void alloc_stats_set_call_site(const char *file, u32 line);
+#define ALLOC_STATS_HERE() alloc_stats_set_call_site(__FILE__, __LINE__)
+
+void* alloc_stats_alloc_opaque(void *ctx, size_t size, size_t alignment);
+void* alloc_stats_realloc_opaque(void *ctx, void *old_mem, size_t old_size, size_t new_size, size_t alignment);
+void alloc_stats_free_opaque(void *ctx, void *mem, size_t size);
+void alloc_stats_clear_opaque(void *ctx);
+
+#define ALLOC_STATS_VTABLE { .alloc = alloc_stats_alloc_opaque,\
+                             .realloc = alloc_stats_realloc_opaque,\
+                             .free = alloc_stats_free_opaque,\
+                             .clear = alloc_stats_clear_opaque }
+#define ALLOC_STATS_POLY(alloc_stats) { .vtable = ALLOC_STATS_VTABLE, .ctx = alloc_stats }
+
+#endif // alloc_stats_h_INCLUDED
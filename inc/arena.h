@@ -4,18 +4,77 @@
 #include "common.h"
 #include "poly_allocator.h"
 
+typedef enum ArenaFlags {
+    ARENA_FLAG_NONE = 0,
+    // buf is a reserved address range, pages are committed as offset grows
+    ARENA_FLAG_VIRTUAL = 1 << 0,
+    // arena_clear returns committed pages to the OS
+    ARENA_FLAG_DECOMMIT_ON_CLEAR = 1 << 1,
+    // back a virtual arena with 2 MiB pages: MAP_HUGETLB first for ranges up
+    // to ARENA_HUGETLB_MAX_RESERVE, then transparent huge pages, then plain
+    // pages; check page_size for the outcome
+    ARENA_FLAG_HUGE_PAGES = 1 << 2,
+} ArenaFlags;
+
+enum { ARENA_COMMIT_GRANULARITY = 64 * 1024 };
+enum { ARENA_HUGE_PAGE_SIZE = 2 * 1024 * 1024 };
+// hugetlb mappings reserve their whole range from the pool at mmap time
+enum { ARENA_HUGETLB_MAX_RESERVE = 256 * 1024 * 1024 };
+
+typedef enum ArenaPageKind {
+    ARENA_PAGE_KIND_DEFAULT = 0,
+    // madvise(MADV_HUGEPAGE), the kernel may still hand out small pages
+    ARENA_PAGE_KIND_TRANSPARENT_HUGE,
+    ARENA_PAGE_KIND_HUGETLB,
+} ArenaPageKind;
+
 typedef struct Arena {
     u8 *buf;
     size_t prev_offset;
     size_t offset;
+    // largest offset since init, survives clears and temps
+    size_t high_water;
     size_t size;
+    size_t committed;
+    size_t commit_granularity;
+    size_t page_size;
+    ArenaPageKind page_kind;
+    u32 flags;
+    u32 temp_depth;
 } Arena;
 
+// checkpoint of an arena, everything allocated after begin is dropped on end
+typedef struct ArenaTemp {
+    Arena *arena;
+    size_t offset;
+    size_t prev_offset;
+    u32 depth;
+} ArenaTemp;
+
+enum { ARENA_SCRATCH_COUNT = 2 };
+enum { ARENA_SCRATCH_RESERVE = 64 * 1024 * 1024 };
+
 void arena_init(Arena *arena, u8 *buf, size_t buf_size);
+// reserves reserve_size bytes of address space without backing them with memory
+bool arena_init_virtual(Arena *arena, size_t reserve_size, u32 flags);
+// unmaps a virtual arena, no-op for buffer-backed ones
+void arena_release(Arena *arena);
 void arena_clear(Arena *arena);
 void* arena_alloc(Arena *arena, size_t size, size_t alignment);
 void* arena_realloc(Arena *arena, void *old_mem, size_t old_size, size_t new_size, size_t alignment);
 
+// temps must be ended in reverse order of beginning
+ArenaTemp arena_temp_begin(Arena *arena);
+void arena_temp_end(ArenaTemp temp);
+
+// per-thread scratch arena that is not `conflict`, pass the arena results are written to
+ArenaTemp arena_scratch_begin(const Arena *conflict);
+// largest high_water of this thread's scratch arenas
+size_t arena_scratch_high_water(void);
+static inline void arena_scratch_end(ArenaTemp temp) {
+    arena_temp_end(temp);
+}
+
 static inline void* arena_alloc_opaque(void* arena, size_t size, size_t alignment) {
     return arena_alloc(arena, size, alignment);
 }
@@ -28,16 +87,16 @@ static inline void* arena_realloc_opaque(void* arena, void *old_mem, size_t old_
     return arena_realloc(arena, old_mem, old_size, new_size, alignment);
 }
 
-static inline void arena_free_opaque(void* arena, size_t size, size_t alignment) {
+static inline void arena_free_opaque(void* arena, void *mem, size_t size) {
     UNUSED(arena);
+    UNUSED(mem);
     UNUSED(size);
-    UNUSED(alignment);
 }
 
 #define ARENA_VTABLE { .alloc = arena_alloc_opaque,\
                        .realloc = arena_realloc_opaque,\
                        .free = arena_free_opaque,\
-                       .clear = arena_free_opaque }
+                       .clear = arena_clear_opaque }
 #define ARENA_POLY(arena) { .vtable = ARENA_VTABLE, .ctx = arena }
 
 #define ARENA_MAKE_3(arena, type, count) ((type*)(arena_alloc(arena, sizeof(type) * (count), alignof(type))))
@@ -45,4 +104,3 @@ static inline void arena_free_opaque(void* arena, size_t size, size_t alignment)
 #define ARENA_MAKE(...) (CAT(ARENA_MAKE_, NARGS(__VA_ARGS__)) (__VA_ARGS__) )
 
 #endif // arena_h_INCLUDED
-
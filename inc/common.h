@@ -119,4 +119,9 @@ static inline uintptr_t align_forward(uintptr_t addr, size_t align) {
     return ret_val;
 }
 
+static inline uintptr_t align_backward(uintptr_t addr, size_t align) {
+    MY_ASSERT(is_power_of_two(align));
+    return addr & ~(uintptr_t)(align-1);
+}
+
 #endif // common_h_INCLUDED
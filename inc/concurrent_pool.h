@@ -0,0 +1,219 @@
+#ifndef concurrent_pool_h_INCLUDED
+#define concurrent_pool_h_INCLUDED
+
+#include <stdatomic.h>
+
+#include "poly_allocator.h"
+#include "common.h"
+
+// Fixed-size pool shared between threads.
+// Free elements live in batches on a lock-free stack, each thread
+// allocates and frees through its own ConcurrentPoolCache (magazine) and only
+// touches the shared stack once per CONCURRENT_POOL_BATCH_SIZE operations.
+//
+// The stack head is a tagged pointer: low 48 bits are the address, high 16
+// bits are a counter bumped on every successful CAS to defeat ABA.
+
+enum { CONCURRENT_POOL_BATCH_SIZE = 32 };
+enum { CONCURRENT_POOL_PTR_BITS = 48 };
+#define CONCURRENT_POOL_PTR_MASK ((((u64)1) << CONCURRENT_POOL_PTR_BITS) - 1)
+
+typedef struct ConcurrentPool {
+    AllocatorPoly backing_allocator;
+    size_t elem_size;
+    size_t elem_alignment;
+    size_t stride;
+    // of the batch link, past the bytes the element's owner writes
+    size_t link_offset;
+    size_t slab_elem_cnt;
+    _Atomic u64 batches;
+    _Atomic u32 slab_cnt;
+    // guards backing_allocator, which is not expected to be thread-safe
+    atomic_flag refill_lock;
+} ConcurrentPool;
+
+typedef struct ConcurrentPoolCache {
+    ConcurrentPool *pool;
+    uintptr_t magazine;
+    u32 magazine_cnt;
+} ConcurrentPoolCache;
+
+// while an element sits in the pool its first word links elements inside a
+// batch. Batches are linked on the shared stack through a word after the
+// element instead: a pop may read it from a head another thread has popped
+// and handed out meanwhile, and the new owner never writes there.
+typedef struct ConcurrentPoolNode {
+    uintptr_t next;
+} ConcurrentPoolNode;
+
+static inline _Atomic uintptr_t* concurrent_pool_batch_link(const ConcurrentPool *pool, uintptr_t batch) {
+    return (_Atomic uintptr_t*)(batch + pool->link_offset);
+}
+
+static inline void concurrent_pool_init(ConcurrentPool *pool, AllocatorPoly backing_allocator, size_t elem_size, size_t elem_alignment, size_t slab_batch_cnt) {
+    MY_ASSERT(is_power_of_two(elem_alignment));
+    MY_ASSERT(slab_batch_cnt);
+    const size_t alignment = elem_alignment > alignof(ConcurrentPoolNode) ? elem_alignment : alignof(ConcurrentPoolNode);
+    const size_t size = elem_size > sizeof(ConcurrentPoolNode) ? elem_size : sizeof(ConcurrentPoolNode);
+    pool->backing_allocator = backing_allocator;
+    pool->elem_size = elem_size;
+    pool->elem_alignment = alignment;
+    pool->link_offset = align_forward(size, alignof(_Atomic uintptr_t));
+    pool->stride = align_forward(pool->link_offset + sizeof(_Atomic uintptr_t), alignment);
+    pool->slab_elem_cnt = slab_batch_cnt * CONCURRENT_POOL_BATCH_SIZE;
+    atomic_init(&pool->batches, 0);
+    atomic_init(&pool->slab_cnt, 0);
+    atomic_flag_clear(&pool->refill_lock);
+}
+
+static inline void concurrent_pool_push_batch(ConcurrentPool *pool, uintptr_t batch) {
+    MY_ASSERT((batch & ~CONCURRENT_POOL_PTR_MASK) == 0);
+    _Atomic uintptr_t *const link = concurrent_pool_batch_link(pool, batch);
+    u64 old = atomic_load_explicit(&pool->batches, memory_order_relaxed);
+    u64 new;
+    do {
+        atomic_store_explicit(link, old & CONCURRENT_POOL_PTR_MASK, memory_order_relaxed);
+        const u64 tag = (old >> CONCURRENT_POOL_PTR_BITS) + 1;
+        new = (tag << CONCURRENT_POOL_PTR_BITS) | batch;
+    } while (!atomic_compare_exchange_weak_explicit(&pool->batches, &old, new, memory_order_release, memory_order_relaxed));
+}
+
+static inline uintptr_t concurrent_pool_pop_batch(ConcurrentPool *pool) {
+    u64 old = atomic_load_explicit(&pool->batches, memory_order_acquire);
+    u64 new;
+    do {
+        const uintptr_t head = old & CONCURRENT_POOL_PTR_MASK;
+        if (!head) {
+            return 0;
+        }
+        // head may be popped and pushed again by another thread meanwhile,
+        // the value read is stale then but the tag makes the CAS fail.
+        // Slabs are never returned to the backing allocator, so the read
+        // itself is always to mapped memory.
+        const uintptr_t next = atomic_load_explicit(concurrent_pool_batch_link(pool, head), memory_order_relaxed);
+        const u64 tag = (old >> CONCURRENT_POOL_PTR_BITS) + 1;
+        new = (tag << CONCURRENT_POOL_PTR_BITS) | next;
+    } while (!atomic_compare_exchange_weak_explicit(&pool->batches, &old, new, memory_order_acquire, memory_order_acquire));
+    return old & CONCURRENT_POOL_PTR_MASK;
+}
+
+// carves a slab into batches, keeps the first one and publishes the rest
+static inline uintptr_t concurrent_pool_refill(ConcurrentPool *pool) {
+    while (atomic_flag_test_and_set_explicit(&pool->refill_lock, memory_order_acquire)) {
+    }
+    // someone may have refilled while we were spinning
+    uintptr_t ret_val = concurrent_pool_pop_batch(pool);
+    if (ret_val) {
+        atomic_flag_clear_explicit(&pool->refill_lock, memory_order_release);
+        return ret_val;
+    }
+    u8 *const slab = allocator_poly_alloc(pool->backing_allocator, pool->stride * pool->slab_elem_cnt, pool->elem_alignment);
+    atomic_flag_clear_explicit(&pool->refill_lock, memory_order_release);
+    if (!slab) {
+        return 0;
+    }
+    atomic_fetch_add_explicit(&pool->slab_cnt, 1, memory_order_relaxed);
+    const size_t batch_bytes = pool->stride * CONCURRENT_POOL_BATCH_SIZE;
+    for (u8 *batch = slab; batch < slab + pool->stride * pool->slab_elem_cnt; batch += batch_bytes) {
+        u8 *elem = batch;
+        for (u32 i=0; i<CONCURRENT_POOL_BATCH_SIZE-1; i++, elem += pool->stride) {
+            ((ConcurrentPoolNode*)elem)->next = (uintptr_t)(elem + pool->stride);
+        }
+        ((ConcurrentPoolNode*)elem)->next = 0;
+        if (batch != slab) {
+            concurrent_pool_push_batch(pool, (uintptr_t)batch);
+        }
+    }
+    return (uintptr_t)slab;
+}
+
+// not thread-safe: every cache of the pool must be dropped before and reinitialized after
+static inline void concurrent_pool_clear(ConcurrentPool *pool) {
+    allocator_poly_clear(pool->backing_allocator);
+    atomic_store(&pool->batches, 0);
+    atomic_store(&pool->slab_cnt, 0);
+}
+
+static inline void concurrent_pool_cache_init(ConcurrentPoolCache *cache, ConcurrentPool *pool) {
+    cache->pool = pool;
+    cache->magazine = 0;
+    cache->magazine_cnt = 0;
+}
+
+static inline void* concurrent_pool_cache_alloc(ConcurrentPoolCache *cache) {
+    if (!cache->magazine) {
+        uintptr_t batch = concurrent_pool_pop_batch(cache->pool);
+        if (!batch) {
+            batch = concurrent_pool_refill(cache->pool);
+        }
+        if (!batch) {
+            return NULL;
+        }
+        cache->magazine = batch;
+        // batches pushed by concurrent_pool_cache_flush can be short, count them
+        cache->magazine_cnt = 0;
+        for (uintptr_t elem = batch; elem; elem = ((ConcurrentPoolNode*)elem)->next) {
+            cache->magazine_cnt++;
+        }
+    }
+    ConcurrentPoolNode *const node = (ConcurrentPoolNode*)cache->magazine;
+    cache->magazine = node->next;
+    cache->magazine_cnt--;
+    return node;
+}
+
+static inline void concurrent_pool_cache_free(ConcurrentPoolCache *cache, void *mem) {
+    ConcurrentPoolNode *const node = mem;
+    node->next = cache->magazine;
+    cache->magazine = (uintptr_t)node;
+    cache->magazine_cnt++;
+    if (cache->magazine_cnt < CONCURRENT_POOL_BATCH_SIZE * 2) {
+        return;
+    }
+    // hand the newest batch back, keep the rest hot in this thread
+    const uintptr_t batch = cache->magazine;
+    ConcurrentPoolNode *last = node;
+    for (u32 i=0; i<CONCURRENT_POOL_BATCH_SIZE-1; i++) {
+        last = (ConcurrentPoolNode*)last->next;
+    }
+    cache->magazine = last->next;
+    last->next = 0;
+    cache->magazine_cnt -= CONCURRENT_POOL_BATCH_SIZE;
+    concurrent_pool_push_batch(cache->pool, batch);
+}
+
+// returns everything cached to the shared stack, call before the owning thread exits
+static inline void concurrent_pool_cache_flush(ConcurrentPoolCache *cache) {
+    if (cache->magazine) {
+        concurrent_pool_push_batch(cache->pool, cache->magazine);
+    }
+    cache->magazine = 0;
+    cache->magazine_cnt = 0;
+}
+
+static inline void* concurrent_pool_cache_alloc_opaque(void *ctx, size_t size, size_t alignment) {
+    ConcurrentPoolCache *const cache = ctx;
+    MY_ASSERT(size <= cache->pool->elem_size);
+    MY_ASSERT(alignment <= cache->pool->elem_alignment);
+    return concurrent_pool_cache_alloc(cache);
+}
+
+static inline void concurrent_pool_cache_free_opaque(void *ctx, void *mem, size_t size) {
+    ConcurrentPoolCache *const cache = ctx;
+    MY_ASSERT(size <= cache->pool->elem_size);
+    concurrent_pool_cache_free(cache, mem);
+}
+
+static inline void concurrent_pool_cache_clear_opaque(void *ctx) {
+    ConcurrentPoolCache *const cache = ctx;
+    concurrent_pool_clear(cache->pool);
+    concurrent_pool_cache_init(cache, cache->pool);
+}
+
+// ctx is the calling thread's ConcurrentPoolCache, never share one between threads
+#define CONCURRENT_POOL_VTABLE { .alloc = concurrent_pool_cache_alloc_opaque,\
+                       .free = concurrent_pool_cache_free_opaque,\
+                       .clear = concurrent_pool_cache_clear_opaque }
+#define CONCURRENT_POOL_POLY(concurrent_pool_cache) { .vtable = CONCURRENT_POOL_VTABLE, .ctx = concurrent_pool_cache }
+
+#endif // concurrent_pool_h_INCLUDED
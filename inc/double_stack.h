@@ -0,0 +1,76 @@
+#ifndef double_stack_h_INCLUDED
+#define double_stack_h_INCLUDED
+
+#include "common.h"
+#include "arena.h"
+#include "poly_allocator.h"
+
+// Two stacks growing toward each other in one buffer.
+// The persistent end is a plain Arena at the bottom of the buffer, and every
+// Arena API works on it. The transient end grows down from the top and pulls
+// persistent.size down with it. An allocation that would run into the other
+// end returns NULL. Rolling the transient end back to a marker drops a whole
+// level in O(1).
+
+typedef enum DoubleStackEnd {
+    DOUBLE_STACK_PERSISTENT = 0,
+    DOUBLE_STACK_TRANSIENT,
+} DoubleStackEnd;
+
+typedef struct DoubleStack {
+    // persistent.size is the bottom of the transient end
+    Arena persistent;
+    // whole buffer, the transient end is empty when persistent.size == capacity
+    size_t capacity;
+    // lowest committed offset of the transient end, 0 for buffer-backed stacks
+    size_t transient_committed;
+} DoubleStack;
+
+typedef struct DoubleStackMarker {
+    DoubleStackEnd end;
+    size_t offset;
+    size_t prev_offset;
+} DoubleStackMarker;
+
+void double_stack_init(DoubleStack *stack, u8 *buf, size_t buf_size);
+// flags are ArenaFlags except DECOMMIT_ON_CLEAR, both ends commit pages as they grow
+bool double_stack_init_virtual(DoubleStack *stack, size_t reserve_size, u32 flags);
+void double_stack_release(DoubleStack *stack);
+// empties both ends
+void double_stack_clear(DoubleStack *stack);
+size_t double_stack_remaining(const DoubleStack *stack);
+
+void* double_stack_transient_alloc(DoubleStack *stack, size_t size, size_t alignment);
+void* double_stack_transient_realloc(DoubleStack *stack, void *old_mem, size_t old_size, size_t new_size, size_t alignment);
+// only the topmost transient allocation is given back, anything else waits for a rollback
+void double_stack_transient_free(DoubleStack *stack, void *mem, size_t size);
+void double_stack_transient_clear(DoubleStack *stack);
+
+DoubleStackMarker double_stack_marker(const DoubleStack *stack, DoubleStackEnd end);
+// frees everything allocated on the marker's end since the marker was taken
+void double_stack_rollback(DoubleStack *stack, DoubleStackMarker marker);
+
+static inline void* double_stack_transient_alloc_opaque(void *stack, size_t size, size_t alignment) {
+    return double_stack_transient_alloc(stack, size, alignment);
+}
+
+static inline void* double_stack_transient_realloc_opaque(void *stack, void *old_mem, size_t old_size, size_t new_size, size_t alignment) {
+    return double_stack_transient_realloc(stack, old_mem, old_size, new_size, alignment);
+}
+
+static inline void double_stack_transient_free_opaque(void *stack, void *mem, size_t size) {
+    double_stack_transient_free(stack, mem, size);
+}
+
+static inline void double_stack_transient_clear_opaque(void *stack) {
+    double_stack_transient_clear(stack);
+}
+
+#define DOUBLE_STACK_TRANSIENT_VTABLE { .alloc = double_stack_transient_alloc_opaque,\
+                                        .realloc = double_stack_transient_realloc_opaque,\
+                                        .free = double_stack_transient_free_opaque,\
+                                        .clear = double_stack_transient_clear_opaque }
+#define DOUBLE_STACK_TRANSIENT_POLY(stack) { .vtable = DOUBLE_STACK_TRANSIENT_VTABLE, .ctx = stack }
+#define DOUBLE_STACK_PERSISTENT_POLY(stack) { .vtable = ARENA_VTABLE, .ctx = &(stack)->persistent }
+
+#endif // double_stack_h_INCLUDED
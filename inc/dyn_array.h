@@ -0,0 +1,87 @@
+#ifndef dyn_array_h_INCLUDED
+#define dyn_array_h_INCLUDED
+
+#include <string.h>
+
+#include "common.h"
+#include "poly_allocator.h"
+
+// Growable array over an AllocatorPoly, instantiated per element type:
+//     DYN_ARRAY_DEFINE(MeshHandleArray, mesh_handle_array, MeshHandle)
+// Growth doubles through allocator_poly_realloc, so an arena that still has
+// the array as its last allocation grows it in place without copying.
+
+#define DYN_ARRAY_DEFINE(NAME, PREFIX, ELEM) \
+typedef struct NAME { \
+    ELEM *data; \
+    u32 size; \
+    u32 cap; \
+    AllocatorPoly alloc; \
+} NAME; \
+\
+static inline void PREFIX##_init(NAME *arr, AllocatorPoly alloc) { \
+    arr->data = NULL; \
+    arr->size = 0; \
+    arr->cap = 0; \
+    arr->alloc = alloc; \
+} \
+\
+static inline bool PREFIX##_reserve(NAME *arr, u32 cap) { \
+    if (cap <= arr->cap) { \
+        return true; \
+    } \
+    u32 new_cap = arr->cap ? arr->cap : 8; \
+    while (new_cap < cap) { \
+        new_cap *= 2; \
+    } \
+    ELEM *const data = allocator_poly_realloc(arr->alloc, arr->data, sizeof(ELEM) * arr->cap, sizeof(ELEM) * new_cap, alignof(ELEM)); \
+    if (!data) { \
+        return false; \
+    } \
+    arr->data = data; \
+    arr->cap = new_cap; \
+    return true; \
+} \
+\
+/* returns the new uninitialized last element, NULL when out of memory */ \
+static inline ELEM* PREFIX##_push(NAME *arr) { \
+    if (arr->size == arr->cap && !PREFIX##_reserve(arr, arr->size + 1)) { \
+        return NULL; \
+    } \
+    return &arr->data[arr->size++]; \
+} \
+\
+static inline bool PREFIX##_append(NAME *arr, ELEM val) { \
+    ELEM *const slot = PREFIX##_push(arr); \
+    if (!slot) { \
+        return false; \
+    } \
+    *slot = val; \
+    return true; \
+} \
+\
+static inline ELEM PREFIX##_pop(NAME *arr) { \
+    MY_ASSERT(arr->size); \
+    return arr->data[--arr->size]; \
+} \
+\
+/* O(1), moves the last element into the hole */ \
+static inline void PREFIX##_swap_remove(NAME *arr, u32 index) { \
+    MY_ASSERT(index < arr->size); \
+    arr->data[index] = arr->data[--arr->size]; \
+} \
+\
+static inline void PREFIX##_clear(NAME *arr) { \
+    arr->size = 0; \
+} \
+\
+static inline void PREFIX##_free(NAME *arr) { \
+    if (arr->data) { \
+        allocator_poly_free(arr->alloc, arr->data, sizeof(ELEM) * arr->cap); \
+    } \
+    arr->data = NULL; \
+    arr->size = 0; \
+    arr->cap = 0; \
+}
+
+#endif // dyn_array_h_INCLUDED
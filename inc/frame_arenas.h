@@ -0,0 +1,35 @@
+#ifndef frame_arenas_h_INCLUDED
+#define frame_arenas_h_INCLUDED
+
+#include <GL/glew.h>
+
+#include "common.h"
+#include "arena.h"
+#include "poly_allocator.h"
+
+// Ring of per-frame arenas, one per frame the GPU may still have in flight.
+// An arena is only cleared and handed out again once the fence inserted at
+// the end of its frame has signalled, so data the GPU reads after
+// SDL_GL_SwapWindow can live there.
+
+enum { FRAME_ARENAS_MAX_DEPTH = 4 };
+
+typedef struct FrameArenas {
+    Arena arenas[FRAME_ARENAS_MAX_DEPTH];
+    GLsync fences[FRAME_ARENAS_MAX_DEPTH];
+    u32 depth;
+    u32 current;
+    // frames where begin had to block on the GPU
+    u64 stall_cnt;
+} FrameArenas;
+
+bool frame_arenas_init(FrameArenas *ring, AllocatorPoly backing, size_t arena_size, u32 depth);
+void frame_arenas_destroy(FrameArenas *ring);
+// waits until the oldest frame retired, then returns its cleared arena
+Arena* frame_arenas_begin(FrameArenas *ring);
+// call after the last GL command of the frame
+void frame_arenas_end(FrameArenas *ring);
+// peak usage of any arena in the ring, temps included
+size_t frame_arenas_high_water(const FrameArenas *ring);
+
+#endif // frame_arenas_h_INCLUDED
@@ -4,41 +4,271 @@
 #include <GL/glew.h>
 
 #include "common.h"
+#include "arena.h"
+#include "gl_stream.h"
+#include "poly_allocator.h"
+#include "vertex.h"
 
+// frames the GPU may still be reading per-frame data of
+enum { GL_FRAMES_IN_FLIGHT = 3 };
+
+// generation 0 is never handed out, so a zeroed handle is always stale
 typedef struct MeshHandle {
     u32 index;
+    u32 generation;
 } MeshHandle;
 
-typedef struct Vertex {
-    f32 coord[3];
-    f32 texcoord[2];
-    f32 normal[3];
-    f32 color[3];
-} Vertex;
+// Vertex formats, each one a vertex struct, an encoder from Vertex and the
+// attributes the shaders read from it:
+//     X(NAME, STRUCT, ATTRIBS_X, ENCODE_FN, BOUNDS_RELATIVE, OCT_NORMALS)
+// ENCODE_FN is a VertexEncodeFn, NULL uploads the Vertex array as is. The
+// structs and encoders are in vertex_pack.h, only gl.c expands this list.
+// BOUNDS_RELATIVE coords are in [-1, 1] of the mesh bounds. OCT_NORMALS
+// formats store the normal octahedral in xy, see GlVertexFormatBlock.
+// An attribute list is
+//     X(LOCATION, COMPONENTS, GL_TYPE, GlVertexAttribMode, STRUCT, MEMBER)
+// Formats with identical attributes and stride share one pool and VAO.
+// Every vertex struct starts with its position in coord, which is stored in
+// its own tightly packed stream; the other members go to a second stream.
+#define GL_VERTEX_ATTRIBS_VERTEX_X(X)\
+    X(0, 3, GL_FLOAT, GL_VERTEX_ATTRIB_FLOAT, Vertex, coord)\
+    X(1, 2, GL_FLOAT, GL_VERTEX_ATTRIB_FLOAT, Vertex, texcoord)\
+    X(2, 3, GL_FLOAT, GL_VERTEX_ATTRIB_FLOAT, Vertex, normal)\
+    X(3, 3, GL_FLOAT, GL_VERTEX_ATTRIB_FLOAT, Vertex, color)
+
+#define GL_VERTEX_ATTRIBS_PACKED_X(X)\
+    X(0, 3, GL_SHORT, GL_VERTEX_ATTRIB_NORMALIZED, PackedVertex, coord)\
+    X(1, 2, GL_HALF_FLOAT, GL_VERTEX_ATTRIB_FLOAT, PackedVertex, texcoord)\
+    X(2, 2, GL_SHORT, GL_VERTEX_ATTRIB_NORMALIZED, PackedVertex, normal)\
+    X(3, 4, GL_UNSIGNED_BYTE, GL_VERTEX_ATTRIB_NORMALIZED, PackedVertex, color)
+
+#define GL_VERTEX_ATTRIBS_COLORED_X(X)\
+    X(0, 3, GL_SHORT, GL_VERTEX_ATTRIB_NORMALIZED, ColoredVertex, coord)\
+    X(3, 4, GL_UNSIGNED_BYTE, GL_VERTEX_ATTRIB_NORMALIZED, ColoredVertex, color)
+
+#define GL_VERTEX_FORMATS_X(X)\
+    X(VERTEX, Vertex, GL_VERTEX_ATTRIBS_VERTEX_X, NULL, false, false)\
+    X(PACKED, PackedVertex, GL_VERTEX_ATTRIBS_PACKED_X, vertex_pack, true, true)\
+    X(COLORED, ColoredVertex, GL_VERTEX_ATTRIBS_COLORED_X, vertex_pack_colored, true, false)
+
+typedef enum GlVertexFormat {
+#define GL_VERTEX_FORMAT_ENUM(NAME, ...) GL_VERTEX_FORMAT_##NAME,
+    GL_VERTEX_FORMATS_X(GL_VERTEX_FORMAT_ENUM)
+#undef GL_VERTEX_FORMAT_ENUM
+    GL_VERTEX_FORMAT_COUNT,
+} GlVertexFormat;
+
+typedef enum GlVertexAttribMode {
+    // glVertexAttribPointer, not normalized
+    GL_VERTEX_ATTRIB_FLOAT = 0,
+    // glVertexAttribPointer, normalized
+    GL_VERTEX_ATTRIB_NORMALIZED,
+    // glVertexAttribIPointer
+    GL_VERTEX_ATTRIB_INTEGER,
+} GlVertexAttribMode;
+
+// depth, shadow and picking passes only fetch the position stream
+typedef enum GlVertexStream {
+    GL_VERTEX_STREAM_POSITION = 0,
+    GL_VERTEX_STREAM_ATTRIBS,
+    GL_VERTEX_STREAM_COUNT,
+} GlVertexStream;
 
-static_assert(alignof(Vertex) == 4);
-static_assert(sizeof(Vertex) == 11 * sizeof(f32));
+typedef struct GlVertexAttrib {
+    u32 location;
+    u32 components;
+    GLenum type;
+    GlVertexAttribMode mode;
+    GlVertexStream stream;
+    // inside one element of the stream
+    u32 offset;
+} GlVertexAttrib;
+
+typedef struct GlVertexLayout {
+    const char *name;
+    const GlVertexAttrib *attribs;
+    u32 attrib_cnt;
+    // of the struct the encoder writes
+    u32 stride;
+    // a stream with stride 0 has no buffer
+    u32 stream_strides[GL_VERTEX_STREAM_COUNT];
+    VertexEncodeFn *encode;
+    bool bounds_relative;
+    bool oct_normals;
+} GlVertexLayout;
+
+const GlVertexLayout* gl_vertex_layout(GlVertexFormat format);
+// compares what a VAO captures and the normal decode, names, encoders and
+// bounds handling may differ; gl_init gives formats with equal layouts one pool
+bool gl_vertex_layouts_equal(const GlVertexLayout *a, const GlVertexLayout *b);
+// true when meshes of both formats live in the same buffers and can batch together
+bool gl_vertex_formats_share_pool(GlVertexFormat a, GlVertexFormat b);
 
 typedef struct Mesh {
     Vertex *verts;
     GLuint *indices;
     size_t indices_cnt;
+    u32 vert_cnt;
+    GlVertexFormat format;
+    // GL_UNSIGNED_SHORT when vert_cnt allows it, GL_UNSIGNED_INT otherwise;
+    // indices still holds the caller's GLuint copy
+    GLenum index_type;
+    // element offsets of the mesh's ranges in the shared buffers of its
+    // format, first_index counts elements of index_type
+    u32 base_vertex;
+    u32 first_index;
+    // bounds relative formats: coord = center + extent * stored coord
+    f32 center[3];
+    f32 extent[3];
 } Mesh;
 
 
 typedef enum GlError {
     GL_ERROR_NONE = 0,
     GL_ERROR_BUFF_SIZE_TOO_SMALL,
+    GL_ERROR_OUT_OF_MEMORY,
 } GlError;
 
-void gl_init(u32 max_mesh_cnt, Mesh meshes_buf[static max_mesh_cnt], GLuint vaos_ebos_buf[static max_mesh_cnt * 2], GLuint vbo_sets_buf[static max_mesh_cnt]);
-void gl_mesh_init(u32 n, MeshHandle handle_buf[static n], Vertex *verts[static n], GLuint *indices[static n], u32 vert_cnts[static n], u32 indices_cnt[static n]);
-GLuint* gl_mesh_get_vao(MeshHandle handle);
+// mesh storage grows through alloc, pointers from gl_mesh_get_data are invalidated by gl_mesh_init
+GlError gl_init(AllocatorPoly alloc, u32 initial_mesh_cap);
+// deletes the shared buffers, every mesh must be destroyed first
+void gl_deinit(void);
+// Shadow state: calls that would not change the cached binding or
+// capability are elided, GL is never queried. State changed with raw GL
+// calls behind these wrappers' back is not seen. GL_ELEMENT_ARRAY_BUFFER is
+// VAO state and is not tracked.
+typedef struct GlStateStats {
+    u64 issued;
+    u64 elided;
+} GlStateStats;
+
+void gl_use_program(GLuint prog);
+void gl_bind_vao(GLuint vao);
+void gl_bind_buffer(GLenum target, GLuint buffer);
+// GL_UNIFORM_BUFFER, index below 16
+void gl_bind_buffer_range(GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size);
+// unit is the index past GL_TEXTURE0, targets GL_TEXTURE_2D and GL_TEXTURE_BUFFER
+void gl_bind_texture(u32 unit, GLenum target, GLuint texture);
+// GL_DEPTH_TEST, GL_BLEND or GL_CULL_FACE
+void gl_set_capability(GLenum cap, bool enabled);
+void gl_set_depth_mask(bool write);
+void gl_set_blend_func(GLenum src, GLenum dst);
+void gl_set_viewport(GLint x, GLint y, GLsizei width, GLsizei height);
+// drop the cached bindings of the deleted names
+void gl_delete_buffers(GLsizei n, const GLuint *buffers);
+void gl_delete_textures(GLsizei n, const GLuint *textures);
+const GlStateStats* gl_get_state_stats(void);
+
+// mesh data is copied into ranges of the shared buffers of each mesh's
+// format, which grow when full; packed formats are encoded on the way and
+// positions are split from the other attributes
+GlError gl_mesh_init(u32 n, MeshHandle handle_buf[static n], Vertex *verts[static n], GLuint *indices[static n], u32 vert_cnts[static n], u32 indices_cnt[static n], const GlVertexFormat formats[static n]);
+// returns the mesh ranges to the shared buffers, handles become stale
+void gl_mesh_destroy(u32 n, const MeshHandle handles[static n]);
+bool gl_mesh_is_alive(MeshHandle handle);
 Mesh* gl_mesh_get_data(MeshHandle handle);
-GLuint* gl_mesh_get_vbo(MeshHandle handle);
+// shared between every mesh of the same format, the names change when the buffers grow
+GLuint* gl_mesh_get_vao(MeshHandle handle);
+// reads only the position stream
+GLuint* gl_mesh_get_position_vao(MeshHandle handle);
+GLuint* gl_mesh_get_vbo(MeshHandle handle, GlVertexStream stream);
 GLuint* gl_mesh_get_ebo(MeshHandle handle);
 
 void gl_mesh_draw(MeshHandle handle);
+// for depth only passes, attributes other than the position read as their defaults
+void gl_mesh_draw_positions(MeshHandle handle);
 
-#endif // gl_h_INCLUDED
+// layout glMultiDrawElementsIndirect reads
+typedef struct GlDrawCommand {
+    u32 count;
+    u32 instance_count;
+    u32 first_index;
+    i32 base_vertex;
+    u32 base_instance;
+} GlDrawCommand;
 
+// per-instance data, the vertex shader reads it from a samplerBuffer as
+// GL_INSTANCE_TEXELS RGBA32F texels: four transform columns, then the tint
+typedef struct GlInstance {
+    // laid out the way glUniformMatrix4fv takes it
+    f32 transform[16];
+    f32 tint[4];
+} GlInstance;
+
+enum { GL_INSTANCE_TEXELS = sizeof(GlInstance) / (sizeof(f32) * 4) };
+
+// the vertex shader reads its instance index from this attribute and looks
+// the instance up in a samplerBuffer bound to this texture unit
+enum { GL_INSTANCE_ID_ATTRIB = 4 };
+enum { GL_INSTANCES_TEXTURE_UNIT = 0 };
+
+// a draw as added, the instance is built from it on submit
+typedef struct GlBatchItem {
+    const f32 *transform;
+    const f32 *tint;
+    u32 mesh_index;
+} GlBatchItem;
+
+// draws of one vertex format gathered into an arena, draws that share a
+// mesh are merged into one instanced draw on submit
+typedef struct GlBatch {
+    Arena *arena;
+    GlBatchItem *items;
+    GlVertexFormat format;
+    // set after gl_batch_begin for depth only passes, see gl_mesh_draw_positions
+    bool position_only;
+    u32 size;
+    u32 cap;
+} GlBatch;
+
+// arena bytes per instance between gl_batch_add and gl_batch_submit
+#define GL_BATCH_INSTANCE_BYTES (sizeof(GlBatchItem) + 2 * sizeof(u32) + sizeof(GlInstance) + sizeof(GlDrawCommand))
+
+void gl_batch_begin(GlBatch *batch, Arena *arena);
+// grows the storage once instead of doubling through every add; false when the arena is full
+bool gl_batch_reserve(GlBatch *batch, u32 cap);
+// empties the batch and keeps its storage for the next one
+void gl_batch_clear(GlBatch *batch);
+// transform is 16 floats, tint 4, both are read on submit and must stay
+// valid until then; false when the arena is full
+bool gl_batch_add(GlBatch *batch, MeshHandle handle, const f32 *transform, const f32 *tint);
+// std140 layout of the shaders' Camera uniform block, shared by every program
+typedef struct GlCameraBlock {
+    f32 proj_view[16];
+    // xyz, w is padding
+    f32 eye[4];
+} GlCameraBlock;
+
+enum { GL_CAMERA_BLOCK_BINDING = 0 };
+
+// std140 layout of the shaders' VertexFormat uniform block, one per pool;
+// draws of a pool bind its block, so the decode is picked per layout
+typedef struct GlVertexFormatBlock {
+    u32 oct_normals;
+    u32 pad[3];
+} GlVertexFormatBlock;
+
+enum { GL_VERTEX_FORMAT_BLOCK_BINDING = 1 };
+
+// GLSL 330 has no layout(binding), call after every link
+void gl_program_bind_blocks(GLuint prog);
+// streams the camera into the frame's region and binds it for every program
+// until the next upload; false when the region is full
+bool gl_camera_upload(const GlCameraBlock *camera);
+
+// per-frame batch data goes through a streaming ring, bracket the frame's GL commands
+void gl_frame_begin(void);
+void gl_frame_end(void);
+// stall and byte counters of the ring
+const GlStream* gl_get_stream(void);
+
+// groups the instances by mesh and draws them with the program in use: one
+// glMultiDrawElementsIndirect per index type when the context has it, otherwise one
+// glDrawElementsInstancedBaseVertex per mesh. Returns the number of
+// instanced draws, 0 also when the arena or the frame's stream region is full.
+u32 gl_batch_submit(GlBatch *batch);
+// gl_init turns multi draw indirect on when the context has it; turning it
+// off forces the per-mesh path. False when enabling on a context without it.
+bool gl_set_multi_draw_indirect(bool enabled);
+
+#endif // gl_h_INCLUDED
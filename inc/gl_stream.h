@@ -0,0 +1,55 @@
+#ifndef gl_stream_h_INCLUDED
+#define gl_stream_h_INCLUDED
+
+#include <GL/glew.h>
+
+#include "common.h"
+
+// Ring buffer for data rewritten every frame. The buffer is split into one
+// region per frame in flight. A frame only writes its own region, and a
+// region is reused once the fence from its last frame has signalled.
+
+enum { GL_STREAM_MAX_REGIONS = 4 };
+// returned by gl_stream_push when the frame's region is full
+#define GL_STREAM_FULL SIZE_MAX
+
+typedef enum GlStreamMode {
+    // ARB_buffer_storage: mapped once, persistent and coherent
+    GL_STREAM_MODE_PERSISTENT = 0,
+    // glMapBufferRange(UNSYNCHRONIZED) per push; an unsignalled region
+    // orphans the buffer instead of waiting on it
+    GL_STREAM_MODE_UNSYNCHRONIZED,
+} GlStreamMode;
+
+typedef struct GlStream {
+    GLuint buffer;
+    GlStreamMode mode;
+    // whole buffer, only for GL_STREAM_MODE_PERSISTENT
+    u8 *mapped;
+    size_t size;
+    size_t region_size;
+    u32 region_cnt;
+    u32 region;
+    // write offset inside the current region
+    size_t head;
+    GLsync fences[GL_STREAM_MAX_REGIONS];
+
+    // frames where begin had to block on the GPU
+    u64 stall_cnt;
+    // times the unsynchronized mode orphaned instead of blocking
+    u64 orphan_cnt;
+    u64 bytes_streamed;
+} GlStream;
+
+// size is split evenly between region_cnt frames
+bool gl_stream_init(GlStream *stream, size_t size, u32 region_cnt);
+void gl_stream_destroy(GlStream *stream);
+// moves to the next region, waits for or orphans it if the GPU still reads it
+void gl_stream_begin_frame(GlStream *stream);
+// call after the last GL command reading this frame's data
+void gl_stream_end_frame(GlStream *stream);
+// copies size bytes into the current region at a multiple of alignment
+// (any non-zero value), returns the buffer offset or GL_STREAM_FULL
+size_t gl_stream_push(GlStream *stream, const void *data, size_t size, size_t alignment);
+
+#endif // gl_stream_h_INCLUDED
@@ -0,0 +1,227 @@
+#ifndef hash_map_h_INCLUDED
+#define hash_map_h_INCLUDED
+
+#include <string.h>
+
+#include "common.h"
+#include "poly_allocator.h"
+
+// Open addressing hash map with Robin Hood probing, instantiated per key/value:
+//     HASH_MAP_DEFINE(MeshMap, mesh_map, u32, MeshHandle, hash_u32, eq_u32)
+// Hashes live in their own array (0 marks an empty slot) so probing scans
+// packed u32s and only touches an entry when the full hash matches.
+// Removal shifts the following run back, so there are no tombstones.
+
+static inline u32 hash_u32(u32 key) {
+    key ^= key >> 16;
+    key *= 0x7feb352d;
+    key ^= key >> 15;
+    key *= 0x846ca68b;
+    key ^= key >> 16;
+    return key;
+}
+
+static inline u32 hash_u64(u64 key) {
+    key ^= key >> 33;
+    key *= 0xff51afd7ed558ccdull;
+    key ^= key >> 33;
+    key *= 0xc4ceb9fe1a85ec53ull;
+    key ^= key >> 33;
+    return (u32)key;
+}
+
+static inline u32 hash_bytes(const void *data, size_t size) {
+    const u8 *const bytes = data;
+    u32 hash = 2166136261u;
+    for (size_t i=0; i<size; i++) {
+        hash ^= bytes[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+static inline u32 hash_ptr(const void *ptr) {
+    return hash_u64((uintptr_t)ptr);
+}
+
+static inline u32 hash_sv(StringView sv) {
+    return hash_bytes(sv.data, sv.size);
+}
+
+static inline bool eq_u32(u32 a, u32 b) {
+    return a == b;
+}
+
+static inline bool eq_u64(u64 a, u64 b) {
+    return a == b;
+}
+
+static inline bool eq_ptr(const void *a, const void *b) {
+    return a == b;
+}
+
+static inline bool eq_sv(StringView a, StringView b) {
+    return a.size == b.size && memcmp(a.data, b.data, a.size) == 0;
+}
+
+// 7/8 max load factor
+#define HASH_MAP_NEEDS_GROW(size, cap) ((size) + 1 > (cap) - (cap) / 8)
+
+#define HASH_MAP_DEFINE(NAME, PREFIX, KEY, VAL, HASH_FN, EQ_FN) \
+typedef struct NAME##Entry { \
+    KEY key; \
+    VAL val; \
+} NAME##Entry; \
+\
+typedef struct NAME { \
+    u32 *hashes; \
+    NAME##Entry *entries; \
+    u32 size; \
+    u32 cap; \
+    AllocatorPoly alloc; \
+} NAME; \
+\
+static inline void PREFIX##_init(NAME *map, AllocatorPoly alloc) { \
+    map->hashes = NULL; \
+    map->entries = NULL; \
+    map->size = 0; \
+    map->cap = 0; \
+    map->alloc = alloc; \
+} \
+\
+static inline u32 PREFIX##_hash(KEY key) { \
+    const u32 hash = HASH_FN(key); \
+    return hash ? hash : 1; \
+} \
+\
+static inline u32 PREFIX##_probe_dist(const NAME *map, u32 hash, u32 slot) { \
+    return (slot - hash) & (map->cap - 1); \
+} \
+\
+/* places an entry known to be absent, cap must have room */ \
+static inline VAL* PREFIX##_insert_new(NAME *map, u32 hash, KEY key, VAL val) { \
+    const u32 mask = map->cap - 1; \
+    NAME##Entry entry = { .key = key, .val = val }; \
+    VAL *ret_val = NULL; \
+    u32 dist = 0; \
+    for (u32 slot = hash & mask;; slot = (slot + 1) & mask, dist++) { \
+        if (!map->hashes[slot]) { \
+            map->hashes[slot] = hash; \
+            map->entries[slot] = entry; \
+            map->size++; \
+            return ret_val ? ret_val : &map->entries[slot].val; \
+        } \
+        const u32 slot_dist = PREFIX##_probe_dist(map, map->hashes[slot], slot); \
+        if (slot_dist < dist) { \
+            /* take from the rich: the resident is closer to home than we are */ \
+            const u32 tmp_hash = map->hashes[slot]; \
+            const NAME##Entry tmp_entry = map->entries[slot]; \
+            map->hashes[slot] = hash; \
+            map->entries[slot] = entry; \
+            if (!ret_val) { \
+                ret_val = &map->entries[slot].val; \
+            } \
+            hash = tmp_hash; \
+            entry = tmp_entry; \
+            dist = slot_dist; \
+        } \
+    } \
+} \
+\
+static inline bool PREFIX##_reserve(NAME *map, u32 cap) { \
+    if (cap <= map->cap) { \
+        return true; \
+    } \
+    u32 new_cap = map->cap ? map->cap : 16; \
+    while (new_cap < cap) { \
+        new_cap *= 2; \
+    } \
+    u32 *const hashes = allocator_poly_alloc(map->alloc, sizeof(u32) * new_cap, alignof(u32)); \
+    NAME##Entry *const entries = allocator_poly_alloc(map->alloc, sizeof(NAME##Entry) * new_cap, alignof(NAME##Entry)); \
+    if (!hashes || !entries) { \
+        return false; \
+    } \
+    memset(hashes, 0, sizeof(u32) * new_cap); \
+    u32 *const old_hashes = map->hashes; \
+    NAME##Entry *const old_entries = map->entries; \
+    const u32 old_cap = map->cap; \
+    map->hashes = hashes; \
+    map->entries = entries; \
+    map->cap = new_cap; \
+    map->size = 0; \
+    for (u32 slot=0; slot<old_cap; slot++) { \
+        if (old_hashes[slot]) { \
+            PREFIX##_insert_new(map, old_hashes[slot], old_entries[slot].key, old_entries[slot].val); \
+        } \
+    } \
+    if (old_cap) { \
+        allocator_poly_free(map->alloc, old_entries, sizeof(NAME##Entry) * old_cap); \
+        allocator_poly_free(map->alloc, old_hashes, sizeof(u32) * old_cap); \
+    } \
+    return true; \
+} \
+\
+static inline i64 PREFIX##_find_slot(const NAME *map, u32 hash, KEY key) { \
+    if (!map->cap) { \
+        return -1; \
+    } \
+    const u32 mask = map->cap - 1; \
+    for (u32 slot = hash & mask, dist = 0;; slot = (slot + 1) & mask, dist++) { \
+        const u32 slot_hash = map->hashes[slot]; \
+        /* an entry this far out would have displaced the resident */ \
+        if (!slot_hash || PREFIX##_probe_dist(map, slot_hash, slot) < dist) { \
+            return -1; \
+        } \
+        if (slot_hash == hash && EQ_FN(map->entries[slot].key, key)) { \
+            return slot; \
+        } \
+    } \
+} \
+\
+static inline VAL* PREFIX##_get(const NAME *map, KEY key) { \
+    const i64 slot = PREFIX##_find_slot(map, PREFIX##_hash(key), key); \
+    return slot < 0 ? NULL : &map->entries[slot].val; \
+} \
+\
+/* inserts or overwrites, NULL when out of memory */ \
+static inline VAL* PREFIX##_put(NAME *map, KEY key, VAL val) { \
+    const u32 hash = PREFIX##_hash(key); \
+    const i64 slot = PREFIX##_find_slot(map, hash, key); \
+    if (slot >= 0) { \
+        map->entries[slot].val = val; \
+        return &map->entries[slot].val; \
+    } \
+    if (HASH_MAP_NEEDS_GROW(map->size, map->cap) && !PREFIX##_reserve(map, map->cap ? map->cap * 2 : 16)) { \
+        return NULL; \
+    } \
+    return PREFIX##_insert_new(map, hash, key, val); \
+} \
+\
+static inline bool PREFIX##_remove(NAME *map, KEY key) { \
+    i64 slot = PREFIX##_find_slot(map, PREFIX##_hash(key), key); \
+    if (slot < 0) { \
+        return false; \
+    } \
+    const u32 mask = map->cap - 1; \
+    for (;;) { \
+        const u32 next = (slot + 1) & mask; \
+        if (!map->hashes[next] || PREFIX##_probe_dist(map, map->hashes[next], next) == 0) { \
+            break; \
+        } \
+        map->hashes[slot] = map->hashes[next]; \
+        map->entries[slot] = map->entries[next]; \
+        slot = next; \
+    } \
+    map->hashes[slot] = 0; \
+    map->size--; \
+    return true; \
+} \
+\
+static inline void PREFIX##_clear(NAME *map) { \
+    if (map->hashes) { \
+        memset(map->hashes, 0, sizeof(u32) * map->cap); \
+    } \
+    map->size = 0; \
+}
+
+#endif // hash_map_h_INCLUDED
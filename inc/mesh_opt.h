@@ -0,0 +1,34 @@
+#ifndef mesh_opt_h_INCLUDED
+#define mesh_opt_h_INCLUDED
+
+#include "common.h"
+#include "vertex.h"
+
+// Index and vertex reordering run on meshes before gl_mesh_init. Triangles
+// are ordered with Tipsify (Sander et al. 2007) for the post-transform
+// vertex cache, then its clusters are sorted outside in against overdraw,
+// then vertices are renumbered in first use order for fetch locality. The
+// mesh content is unchanged, only the order of triangles and vertices.
+
+// FIFO entries assumed by the optimizer and reported by the stats
+enum { MESH_OPT_CACHE_SIZE = 16 };
+
+typedef struct MeshCacheStats {
+    // transformed vertices per triangle, 0.5 is the ideal, 3 the worst
+    f32 acmr;
+    // transformed vertices per vertex, 1 is the ideal
+    f32 atvr;
+} MeshCacheStats;
+
+typedef struct MeshOptStats {
+    MeshCacheStats before;
+    MeshCacheStats after;
+} MeshOptStats;
+
+// simulates a FIFO cache of cache_size entries
+MeshCacheStats mesh_cache_stats(const u32 *indices, u32 index_cnt, u32 vert_cnt, u32 cache_size);
+// in place, index_cnt is a multiple of 3; false when the scratch arena is
+// full, the mesh is then left as it was. stats may be NULL.
+bool mesh_optimize(Vertex *verts, u32 vert_cnt, u32 *indices, u32 index_cnt, MeshOptStats *stats);
+
+#endif // mesh_opt_h_INCLUDED
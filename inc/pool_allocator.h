@@ -8,19 +8,46 @@ typedef struct PoolAllocator {
     AllocatorPoly backing_allocator;
     size_t elem_size;
     size_t elem_alignment;
+    // distance between neighbouring elements inside a slab
+    size_t stride;
+    size_t slab_elem_cnt;
+    u32 slab_cnt;
     uintptr_t free_list;
 } PoolAllocator;
 
-static inline void pool_allocator_init(PoolAllocator *alloc, AllocatorPoly backing_allocator, size_t elem_size, size_t elem_alignment) {
+static inline void pool_allocator_init(PoolAllocator *alloc, AllocatorPoly backing_allocator, size_t elem_size, size_t elem_alignment, size_t slab_elem_cnt) {
+    MY_ASSERT(is_power_of_two(elem_alignment));
+    MY_ASSERT(slab_elem_cnt);
+    const size_t alignment = elem_alignment > alignof(uintptr_t) ? elem_alignment : alignof(uintptr_t);
+    const size_t size = elem_size > sizeof(uintptr_t) ? elem_size : sizeof(uintptr_t);
     alloc->elem_size = elem_size;
-    alloc->elem_alignment = elem_alignment;
+    alloc->elem_alignment = alignment;
+    alloc->stride = align_forward(size, alignment);
+    alloc->slab_elem_cnt = slab_elem_cnt;
+    alloc->slab_cnt = 0;
     alloc->free_list = 0;
     alloc->backing_allocator = backing_allocator;
 }
 
+// carves a fresh slab into elements linked in address order
+static inline bool pool_allocator_refill(PoolAllocator *alloc) {
+    u8 *const slab = allocator_poly_alloc(alloc->backing_allocator, alloc->stride * alloc->slab_elem_cnt, alloc->elem_alignment);
+    if (!slab) {
+        return false;
+    }
+    u8 *elem = slab;
+    for (size_t i=0; i<alloc->slab_elem_cnt-1; i++, elem += alloc->stride) {
+        *(uintptr_t*)elem = (uintptr_t)(elem + alloc->stride);
+    }
+    *(uintptr_t*)elem = alloc->free_list;
+    alloc->free_list = (uintptr_t)slab;
+    alloc->slab_cnt++;
+    return true;
+}
+
 static inline void* pool_allocator_alloc(PoolAllocator *alloc) {
-    if (!alloc->free_list) {
-        return allocator_poly_alloc(alloc->backing_allocator, alloc->elem_size, 8);
+    if (!alloc->free_list && !pool_allocator_refill(alloc)) {
+        return NULL;
     }
     void *ret_val = (void*)alloc->free_list;
     alloc->free_list = *( (uintptr_t*)alloc->free_list );
@@ -35,19 +62,19 @@ static inline void pool_allocator_free(PoolAllocator *alloc, void *mem) {
 static inline void pool_allocator_clear(PoolAllocator *alloc) {
     allocator_poly_clear(alloc->backing_allocator);
     alloc->free_list = 0;
+    alloc->slab_cnt = 0;
 }
 
 static inline void* pool_allocator_alloc_opaque(void *ctx, size_t size, size_t alignment) {
     PoolAllocator *const alloc = ctx;
-    MY_ASSERT(size == alloc->elem_size);
-    MY_ASSERT(alignment == alloc->elem_alignment);
+    MY_ASSERT(size <= alloc->elem_size);
+    MY_ASSERT(alignment <= alloc->elem_alignment);
     return pool_allocator_alloc(ctx);
 }
 
-static inline void pool_allocator_free_opaque(void *ctx, void *mem, size_t size, size_t alignment) {
+static inline void pool_allocator_free_opaque(void *ctx, void *mem, size_t size) {
     PoolAllocator *const alloc = ctx;
-    MY_ASSERT(size == alloc->elem_size);
-    MY_ASSERT(alignment == alloc->elem_alignment);
+    MY_ASSERT(size <= alloc->elem_size);
     pool_allocator_free(alloc, mem);
 }
 
@@ -57,7 +84,7 @@ static inline void pool_allocator_clear_opaque(void *ctx) {
 
 #define POOL_ALLOCATOR_VTABLE { .alloc = pool_allocator_alloc_opaque,\
                        .free = pool_allocator_free_opaque,\
-                       .clear = pool_allocator_free_opaque }
+                       .clear = pool_allocator_clear_opaque }
 #define POOL_ALLOCATOR_POLY(pool_allocator) { .vtable = POOL_ALLOCATOR_VTABLE, .ctx = pool_allocator }
 
 #endif // pool_allocator_h_INCLUDED
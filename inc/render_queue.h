@@ -0,0 +1,104 @@
+#ifndef render_queue_h_INCLUDED
+#define render_queue_h_INCLUDED
+
+#include "common.h"
+#include "arena.h"
+#include "gl.h"
+#include "hash_map.h"
+
+// Deferred draws for one frame. Commands are pushed in any order into an
+// arena, each with a 64-bit sort key, and radix sorted on submit. Key layout
+// from the top bit down:
+//     opaque:      layer:4 | 0:1 | program:10 | material:12 | mesh:13 | depth:24
+//     translucent: layer:4 | 1:1 | ~depth:24  | program:10 | material:12 | mesh:13
+// Opaque draws group by state and go front to back inside a group,
+// translucent ones go back to front and only merge consecutive same-mesh draws.
+// GL program names are not dense and change on reload, and mesh slots grow
+// without bound, so the key holds the order in which the queue first saw
+// each program and mesh instead. Items whose ids or material do not fit
+// are dropped.
+
+enum { RENDER_KEY_LAYER_BITS = 4 };
+enum { RENDER_KEY_PROGRAM_BITS = 10 };
+enum { RENDER_KEY_MATERIAL_BITS = 12 };
+enum { RENDER_KEY_MESH_BITS = 13 };
+enum { RENDER_KEY_DEPTH_BITS = 24 };
+
+static_assert(RENDER_KEY_LAYER_BITS + 1 + RENDER_KEY_PROGRAM_BITS + RENDER_KEY_MATERIAL_BITS
+              + RENDER_KEY_MESH_BITS + RENDER_KEY_DEPTH_BITS == 64);
+
+typedef struct RenderItem {
+    MeshHandle mesh;
+    GLuint program;
+    // opaque to the queue, handed to the bind callback
+    u32 material;
+    // layers draw in increasing order, translucent after opaque inside a layer
+    u32 layer;
+    // distance from the camera, negative values sort as 0
+    f32 depth;
+    bool translucent;
+    // 16 floats and 4 floats, read on submit and must stay valid until then
+    const f32 *transform;
+    const f32 *tint;
+} RenderItem;
+
+typedef struct RenderCommand {
+    MeshHandle mesh;
+    GLuint program;
+    u32 material;
+    bool translucent;
+    const f32 *transform;
+    const f32 *tint;
+} RenderCommand;
+
+typedef struct RenderSortEntry {
+    u64 key;
+    u32 index;
+} RenderSortEntry;
+
+HASH_MAP_DEFINE(RenderIdMap, render_id_map, u32, u32, hash_u32, eq_u32)
+
+typedef struct RenderQueue {
+    Arena *arena;
+    // GL program names and mesh slots to the compact ids in the keys, reset every frame
+    RenderIdMap programs;
+    RenderIdMap meshes;
+    RenderCommand *cmds;
+    RenderSortEntry *entries;
+    u32 size;
+    u32 cap;
+    // pushes that found the arena or the ids full, or had an out of range layer or material
+    u32 dropped;
+} RenderQueue;
+
+typedef struct RenderQueueStats {
+    u32 cmd_cnt;
+    // program or material switches
+    u32 state_changes;
+    u32 batches;
+    // instanced draws issued by the batches
+    u32 draws;
+    // commands not drawn: failed pushes, and batches the arena or the stream region had no room for
+    u32 dropped;
+} RenderQueueStats;
+
+// frame arena bytes per pushed item, including what submit and its batches take
+#define RENDER_QUEUE_ITEM_BYTES (sizeof(RenderCommand) + 2 * sizeof(RenderSortEntry) + GL_BATCH_INSTANCE_BYTES)
+
+// called after the program is bound whenever the program or material changes
+typedef void RenderBindFn(void *ctx, GLuint program, u32 material);
+
+// program_id and mesh_id replace item->program and item->mesh, each below
+// 1 << its RENDER_KEY_*_BITS
+u64 render_key(const RenderItem *item, u32 program_id, u32 mesh_id);
+void render_queue_begin(RenderQueue *queue, Arena *arena);
+// sizes the queue once for the frame's expected count; false when the arena is full
+bool render_queue_reserve(RenderQueue *queue, u32 cap);
+// false when the arena is full, the frame has more programs or meshes than
+// the key holds, or the layer or material is out of range; the item is
+// counted in the stats' dropped
+bool render_queue_push(RenderQueue *queue, const RenderItem *item);
+// sorts and draws everything in one pass, bind may be NULL
+RenderQueueStats render_queue_submit(RenderQueue *queue, RenderBindFn *bind, void *bind_ctx);
+
+#endif // render_queue_h_INCLUDED
@@ -6,8 +6,8 @@
 #include <GL/glew.h>
 
 #include "common.h"
-
-typedef struct Arena Arena;
+#include "arena.h"
+#include "hash_map.h"
 
 typedef struct ShaderInfo {
     StringView source_file_path;
@@ -21,12 +21,61 @@ typedef struct ShaderInfo {
 
 bool shader_info_init_and_compile(ShaderInfo *res, StringView path, GLenum shaderype);
 
+// index into the manager's name table, stable across reloads
+typedef u32 ShaderName;
+#define SHADER_NAME_NONE UINT32_MAX
+
+enum { SHADER_MGR_MAX_NAMES = 64 };
+enum { SHADER_MGR_NAME_BUF_SIZE = 2048 };
+// sized so the name map never grows past its inline storage
+enum { SHADER_MGR_NAME_MAP_CAP = 128 };
+// largest uniform whose last value is kept to skip redundant uploads, a mat4
+enum { SHADER_VAR_VALUE_SIZE = 64 };
+
+typedef enum ShaderVarKind {
+    // interned but not active in the current program
+    SHADER_VAR_NONE = 0,
+    SHADER_VAR_UNIFORM,
+    SHADER_VAR_ATTRIB,
+    SHADER_VAR_BLOCK,
+} ShaderVarKind;
+
+typedef struct ShaderVar {
+    ShaderVarKind kind;
+    // uniform or attribute location, block index; -1 when inactive
+    GLint location;
+    GLenum type;
+    // array length, data size in bytes for blocks
+    GLint size;
+    bool has_value;
+    alignas(16) u8 value[SHADER_VAR_VALUE_SIZE];
+} ShaderVar;
+
+HASH_MAP_DEFINE(ShaderNameMap, shader_name_map, StringView, ShaderName, hash_sv, eq_sv)
+
+static_assert(!HASH_MAP_NEEDS_GROW(SHADER_MGR_MAX_NAMES, SHADER_MGR_NAME_MAP_CAP));
+
+// the name map points into the manager, it must not move once initialized
 typedef struct ShaderMgr {
     ShaderInfo vertex;
     ShaderInfo fragment;
     int inotify_fd;
     GLuint prog;
     bool have_prog;
+
+    // interned names, a ShaderName indexes names and vars
+    char name_buf[SHADER_MGR_NAME_BUF_SIZE];
+    u32 name_buf_size;
+    StringView names[SHADER_MGR_MAX_NAMES];
+    u32 name_cnt;
+    ShaderNameMap name_map;
+    Arena name_map_arena;
+    alignas(16) u8 name_map_buf[SHADER_MGR_NAME_MAP_CAP * (sizeof(u32) + sizeof(ShaderNameMapEntry)) + 16];
+    // reflection of the current program, refreshed after every link
+    ShaderVar vars[SHADER_MGR_MAX_NAMES];
+
+    u64 upload_cnt;
+    u64 upload_skip_cnt;
 } ShaderMgr;
 
 typedef enum ShaderMgrError {
@@ -44,4 +93,20 @@ ShaderMgrError shader_mgr_reload_shaders(ShaderMgr *mgr, Arena *arena, StringVie
 ShaderMgrError shader_mgr_get_program(ShaderMgr *mgr, GLuint *prog, Arena *arena, StringView *log);
 ShaderMgrError shader_mgr_init(ShaderMgr *mgr, StringView vertex_path, StringView fragment_path, Arena *arena, StringView *log);
 
+// SHADER_NAME_NONE when the table is full
+ShaderName shader_mgr_intern(ShaderMgr *mgr, StringView name);
+const ShaderVar* shader_mgr_var(const ShaderMgr *mgr, ShaderName name);
+// -1 when the name is not an active uniform of the current program
+GLint shader_mgr_uniform_location(const ShaderMgr *mgr, ShaderName name);
+GLint shader_mgr_attrib_location(const ShaderMgr *mgr, ShaderName name);
+// GL_INVALID_INDEX when the name is not an active block
+GLuint shader_mgr_block_index(const ShaderMgr *mgr, ShaderName name);
+
+// upload to the program in use, skipped when the value is the one last uploaded
+// and ignored for inactive uniforms
+void shader_mgr_set_int(ShaderMgr *mgr, ShaderName name, i32 value);
+void shader_mgr_set_float(ShaderMgr *mgr, ShaderName name, f32 value);
+void shader_mgr_set_vec4(ShaderMgr *mgr, ShaderName name, const f32 value[static 4]);
+void shader_mgr_set_mat4(ShaderMgr *mgr, ShaderName name, const f32 value[static 16]);
+
 #endif // SHADER_MANAGER_H_
@@ -0,0 +1,74 @@
+#ifndef tlsf_h_INCLUDED
+#define tlsf_h_INCLUDED
+
+#include "common.h"
+#include "poly_allocator.h"
+
+// Two-Level Segregated Fit allocator over a caller supplied region.
+// Free blocks are binned by size class (first level: power of two,
+// second level: TLSF_SL_COUNT linear steps inside it), a pair of bitmaps
+// finds a fitting non-empty bin in O(1). Neighbouring free blocks are
+// merged on free.
+
+enum { TLSF_ALIGN_LOG2 = 4 };
+enum { TLSF_ALIGN = 1 << TLSF_ALIGN_LOG2 };
+enum { TLSF_SL_COUNT_LOG2 = 5 };
+enum { TLSF_SL_COUNT = 1 << TLSF_SL_COUNT_LOG2 };
+enum { TLSF_FL_SHIFT = TLSF_SL_COUNT_LOG2 + TLSF_ALIGN_LOG2 };
+// blocks up to 1 TiB
+enum { TLSF_FL_MAX_LOG2 = 40 };
+enum { TLSF_FL_COUNT = TLSF_FL_MAX_LOG2 - TLSF_FL_SHIFT + 1 };
+
+typedef struct TlsfBlock TlsfBlock;
+
+typedef struct Tlsf {
+    u32 fl_bitmap;
+    u32 sl_bitmap[TLSF_FL_COUNT];
+    TlsfBlock *blocks[TLSF_FL_COUNT][TLSF_SL_COUNT];
+    u8 *buf;
+    size_t size;
+} Tlsf;
+
+typedef struct TlsfStats {
+    size_t used_bytes;
+    size_t free_bytes;
+    size_t largest_free_block;
+    u32 used_blocks;
+    u32 free_blocks;
+} TlsfStats;
+
+bool tlsf_init(Tlsf *tlsf, u8 *buf, size_t buf_size);
+void tlsf_clear(Tlsf *tlsf);
+void* tlsf_alloc(Tlsf *tlsf, size_t size, size_t alignment);
+void tlsf_free(Tlsf *tlsf, void *mem);
+// grows or shrinks in place when the neighbouring block allows it
+void* tlsf_realloc(Tlsf *tlsf, void *mem, size_t new_size, size_t alignment);
+size_t tlsf_block_size(const void *mem);
+// walks every block, meant for diagnostics
+void tlsf_get_stats(const Tlsf *tlsf, TlsfStats *stats);
+
+static inline void* tlsf_alloc_opaque(void *tlsf, size_t size, size_t alignment) {
+    return tlsf_alloc(tlsf, size, alignment);
+}
+
+static inline void* tlsf_realloc_opaque(void *tlsf, void *old_mem, size_t old_size, size_t new_size, size_t alignment) {
+    UNUSED(old_size);
+    return tlsf_realloc(tlsf, old_mem, new_size, alignment);
+}
+
+static inline void tlsf_free_opaque(void *tlsf, void *mem, size_t size) {
+    UNUSED(size);
+    tlsf_free(tlsf, mem);
+}
+
+static inline void tlsf_clear_opaque(void *tlsf) {
+    tlsf_clear(tlsf);
+}
+
+#define TLSF_VTABLE { .alloc = tlsf_alloc_opaque,\
+                      .realloc = tlsf_realloc_opaque,\
+                      .free = tlsf_free_opaque,\
+                      .clear = tlsf_clear_opaque }
+#define TLSF_POLY(tlsf) { .vtable = TLSF_VTABLE, .ctx = tlsf }
+
+#endif // tlsf_h_INCLUDED
@@ -0,0 +1,22 @@
+#ifndef vertex_h_INCLUDED
+#define vertex_h_INCLUDED
+
+#include "common.h"
+
+// Meshes are built as Vertex arrays; gl_mesh_init encodes them into their
+// vertex format with the format's VertexEncodeFn, see vertex_pack.h.
+typedef struct Vertex {
+    f32 coord[3];
+    f32 texcoord[2];
+    f32 normal[3];
+    f32 color[3];
+} Vertex;
+
+static_assert(alignof(Vertex) == 4);
+static_assert(sizeof(Vertex) == 11 * sizeof(f32));
+
+// dst holds cnt vertices of the format's struct, center and extent are from
+// vertex_bounds for bounds relative formats
+typedef void VertexEncodeFn(void *restrict dst, const Vertex *restrict src, u32 cnt, const f32 center[static 3], const f32 extent[static 3]);
+
+#endif // vertex_h_INCLUDED
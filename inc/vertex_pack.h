@@ -0,0 +1,55 @@
+#ifndef vertex_pack_h_INCLUDED
+#define vertex_pack_h_INCLUDED
+
+#include "common.h"
+#include "vertex.h"
+
+// Vertex structs of the formats in gl.h, the CPU encoders filling them from
+// Vertex and the 16-bit index narrowing. Positions and indices use SSE2 when
+// the compiler targets it. Texcoords use F16C when the CPU has it, checked at
+// runtime unless built with -mf16c. Each has a scalar fallback.
+
+// the position is relative to the mesh bounds, gl_batch_submit folds the
+// bounds into the instance transform
+typedef struct PackedVertex {
+    // snorm16, w is padding
+    i16 coord[4];
+    // half floats
+    u16 texcoord[2];
+    // octahedral snorm16
+    i16 normal[2];
+    // rgba8 unorm
+    u8 color[4];
+} PackedVertex;
+
+static_assert(sizeof(PackedVertex) == 20);
+
+// only what the current shaders read
+typedef struct ColoredVertex {
+    // snorm16 relative to the mesh bounds, w is padding
+    i16 coord[4];
+    // rgba8 unorm
+    u8 color[4];
+} ColoredVertex;
+
+static_assert(sizeof(ColoredVertex) == 12);
+
+// round to nearest even, overflow goes to infinity, NaN stays NaN
+u16 f32_to_half(f32 value);
+f32 half_to_f32(u16 half);
+// n must be unit length
+void oct_encode_snorm16(const f32 n[static 3], i16 out[static 2]);
+void oct_decode_snorm16(const i16 in[static 2], f32 n[static 3]);
+
+// axis-aligned bounds as center and half size, a flat axis gets extent 1 so
+// it never divides by zero
+void vertex_bounds(const Vertex *verts, u32 cnt, f32 center[static 3], f32 extent[static 3]);
+// whether vertex_pack converts texcoords with F16C on this CPU
+bool vertex_pack_has_f16c(void);
+VertexEncodeFn vertex_pack;
+VertexEncodeFn vertex_pack_colored;
+// every index must fit in 16 bits, out of range ones saturate in release
+// builds; uses SSE2 when available
+void index_narrow_u16(u16 *restrict dst, const u32 *restrict src, u32 cnt);
+
+#endif // vertex_pack_h_INCLUDED
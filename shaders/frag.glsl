@@ -1,9 +1,9 @@
 #version 330 core
 out vec4 FragColor;
-in vec3 ourColor;
+in vec4 ourColor;
 
 void main()
 {
-    FragColor = vec4(ourColor.x, ourColor.y, ourColor.z, 1);
+    FragColor = ourColor;
     // FragColor = vec4(0, 0, 0.5, 1);
 }
@@ -1,21 +1,47 @@
 #version 330 core
+// bounds relative formats store xyz relative to the mesh bounds folded into
+// the instance transform. Attributes a format leaves out read as their
+// defaults, see GL_VERTEX_FORMATS_X.
 layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec2 aTexCoord;
 layout (location = 2) in vec3 aNormal;
 layout (location = 3) in vec3 aColor;
+// index of the instance in its batch, see GL_INSTANCE_ID_ATTRIB
+layout (location = 4) in uint aInstanceId;
 
-uniform mat4 model;
-uniform mat4 proj_view;
+// GlCameraBlock, see GL_CAMERA_BLOCK_BINDING
+layout (std140) uniform Camera {
+    mat4 proj_view;
+    vec4 eye;
+};
+// GlVertexFormatBlock of the pool being drawn, see GL_VERTEX_FORMAT_BLOCK_BINDING
+layout (std140) uniform VertexFormat {
+    bool octNormals;
+};
+// GlInstance: four transform columns then the tint, see GL_INSTANCES_TEXTURE_UNIT
+uniform samplerBuffer instances;
 
-out vec3 ourColor;
+out vec4 ourColor;
+
+// octahedral layouts store the normal in xy
+vec3 vertex_normal() {
+    if (!octNormals) {
+        return aNormal;
+    }
+    vec2 e = aNormal.xy;
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    if (n.z < 0) {
+        n.xy = (1.0 - abs(n.yx)) * vec2(n.x >= 0 ? 1 : -1, n.y >= 0 ? 1 : -1);
+    }
+    return normalize(n);
+}
 
 void main() {
-    ourColor = aColor;
+    int base = int(aInstanceId) * 5;
+    mat4 model = mat4(texelFetch(instances, base), texelFetch(instances, base + 1),
+                      texelFetch(instances, base + 2), texelFetch(instances, base + 3));
+    vec4 tint = texelFetch(instances, base + 4);
+    ourColor = vec4(aColor * tint.rgb, tint.a);
     gl_Position = vec4(aPos.x, aPos.y, aPos.z, 1);
     gl_Position *= model * proj_view;
-    // gl_Position.w = 1;
-    // gl_Position += 0.2;
-    // gl_Position *= transform;
-    // gl_Position.z += 1.9;
-    // gl_Position.x -= 0.2;
 }
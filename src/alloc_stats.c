@@ -0,0 +1,160 @@
+#include "alloc_stats.h"
+
+#include <string.h>
+
+static thread_local const char *pending_site_file = NULL;
+static thread_local u32 pending_site_line = 0;
+
+void alloc_stats_init(AllocStats *stats, const char *name, AllocatorPoly inner, u32 flags) {
+    *stats = (AllocStats) {
+        .inner = inner,
+        .name = name,
+        .flags = flags,
+    };
+}
+
+void alloc_stats_enable_call_sites(AllocStats *stats, AllocStatsCallSite *call_sites, u32 call_sites_cap) {
+    MY_ASSERT(is_power_of_two(call_sites_cap));
+    memset(call_sites, 0, sizeof(*call_sites) * call_sites_cap);
+    stats->call_sites = call_sites;
+    stats->call_sites_cap = call_sites_cap;
+    stats->call_sites_dropped = 0;
+}
+
+void alloc_stats_set_call_site(const char *file, u32 line) {
+    pending_site_file = file;
+    pending_site_line = line;
+}
+
+static void record_call_site(AllocStats *stats, size_t size) {
+    const char *const file = pending_site_file ? pending_site_file : "<untagged>";
+    const u32 line = pending_site_line;
+    pending_site_file = NULL;
+    pending_site_line = 0;
+    if (!stats->call_sites) {
+        return;
+    }
+    const u32 mask = stats->call_sites_cap - 1;
+    u32 i = (u32)(((uintptr_t)file >> 3) * 31 + line) & mask;
+    for (u32 probe=0; probe<stats->call_sites_cap; probe++, i = (i + 1) & mask) {
+        AllocStatsCallSite *const site = &stats->call_sites[i];
+        if (!site->file) {
+            site->file = file;
+            site->line = line;
+        }
+        if (site->file == file && site->line == line) {
+            site->alloc_cnt++;
+            site->bytes += size;
+            return;
+        }
+    }
+    stats->call_sites_dropped++;
+}
+
+static u32 histogram_bucket(size_t size) {
+    if (!size) {
+        return 0;
+    }
+    const u32 bucket = 64 - __builtin_clzll(size);
+    return bucket < ALLOC_STATS_HISTOGRAM_BUCKETS ? bucket : ALLOC_STATS_HISTOGRAM_BUCKETS - 1;
+}
+
+// new_block is an allocation the inner allocator keeps on top of the live ones
+static void record_alloc(AllocStats *stats, size_t size, size_t live_delta, bool new_block) {
+    stats->alloc_cnt++;
+    stats->histogram[histogram_bucket(size)]++;
+    stats->bytes_live += live_delta;
+    if (stats->bytes_live > stats->high_water) {
+        stats->high_water = stats->bytes_live;
+    }
+    if (stats->in_frame) {
+        stats->frame_alloc_cnt++;
+        stats->frame_alloc_bytes += live_delta;
+        MY_ASSERT(!(stats->assert_no_frame_growth && (new_block || live_delta)) && "Allocator grew during a steady-state frame");
+    }
+    record_call_site(stats, size);
+}
+
+void* alloc_stats_alloc_opaque(void *ctx, size_t size, size_t alignment) {
+    AllocStats *const stats = ctx;
+    void *const ret_val = allocator_poly_alloc(stats->inner, size, alignment);
+    if (ret_val) {
+        record_alloc(stats, size, size, true);
+    }
+    return ret_val;
+}
+
+void* alloc_stats_realloc_opaque(void *ctx, void *old_mem, size_t old_size, size_t new_size, size_t alignment) {
+    AllocStats *const stats = ctx;
+    void *const ret_val = allocator_poly_realloc(stats->inner, old_mem, old_size, new_size, alignment);
+    if (!ret_val) {
+        return NULL;
+    }
+    if ((stats->flags & ALLOC_STATS_FLAG_NO_FREE) && ret_val != old_mem) {
+        record_alloc(stats, new_size, new_size, true);
+    } else if (new_size >= old_size) {
+        record_alloc(stats, new_size, new_size - old_size, false);
+    } else {
+        stats->bytes_live -= old_size - new_size;
+        record_alloc(stats, new_size, 0, false);
+    }
+    return ret_val;
+}
+
+void alloc_stats_free_opaque(void *ctx, void *mem, size_t size) {
+    AllocStats *const stats = ctx;
+    allocator_poly_free(stats->inner, mem, size);
+    stats->free_cnt++;
+    if (!(stats->flags & ALLOC_STATS_FLAG_NO_FREE)) {
+        stats->bytes_live -= size < stats->bytes_live ? size : stats->bytes_live;
+    }
+}
+
+void alloc_stats_clear_opaque(void *ctx) {
+    AllocStats *const stats = ctx;
+    allocator_poly_clear(stats->inner);
+    stats->bytes_live = 0;
+}
+
+void alloc_stats_begin_frame(AllocStats *stats) {
+    stats->in_frame = true;
+    stats->frame_alloc_cnt = 0;
+    stats->frame_alloc_bytes = 0;
+}
+
+void alloc_stats_end_frame(AllocStats *stats) {
+    stats->in_frame = false;
+}
+
+void alloc_stats_sample_arena(AllocStats *stats, const Arena *arena) {
+    stats->sampled_arena = arena;
+    stats->arena_offset = arena->offset;
+}
+
+void alloc_stats_report(const AllocStats *stats) {
+    SDL_Log("[%s] live=%zu high_water=%zu allocs=%llu frees=%llu frame_allocs=%llu frame_bytes=%zu\n",
+        stats->name, stats->bytes_live, stats->high_water,
+        (unsigned long long)stats->alloc_cnt, (unsigned long long)stats->free_cnt,
+        (unsigned long long)stats->frame_alloc_cnt, stats->frame_alloc_bytes);
+    if (stats->sampled_arena) {
+        const size_t untracked = stats->arena_offset > stats->bytes_live ? stats->arena_offset - stats->bytes_live : 0;
+        SDL_Log("[%s]   arena offset=%zu high_water=%zu untracked=%zu\n", stats->name,
+            stats->arena_offset, stats->sampled_arena->high_water, untracked);
+    }
+    for (u32 i=0; i<ALLOC_STATS_HISTOGRAM_BUCKETS; i++) {
+        if (!stats->histogram[i]) continue;
+        SDL_Log("[%s]   size < %llu: %llu\n", stats->name,
+            (unsigned long long)1 << i, (unsigned long long)stats->histogram[i]);
+    }
+    if (!stats->call_sites) {
+        return;
+    }
+    for (u32 i=0; i<stats->call_sites_cap; i++) {
+        const AllocStatsCallSite *const site = &stats->call_sites[i];
+        if (!site->file) continue;
+        SDL_Log("[%s]   %s:%u allocs=%u bytes=%zu\n", stats->name, site->file, site->line, site->alloc_cnt, site->bytes);
+    }
+    if (stats->call_sites_dropped) {
+        SDL_Log("[%s]   %u allocations from call sites that did not fit the table\n", stats->name, stats->call_sites_dropped);
+    }
+}
@@ -1,5 +1,8 @@
 #include "arena.h"
 
+#include <sys/mman.h>
+#include <unistd.h>
+
 void arena_init(Arena *arena, u8 *buf, size_t buf_size) {
     // MY_ASSERT(is_power_of_two((uintptr_t)buf));
     MY_ASSERT(buf);
@@ -7,44 +10,209 @@ void arena_init(Arena *arena, u8 *buf, size_t buf_size) {
     arena->buf = buf;
     arena->prev_offset = 0;
     arena->offset = 0;
+    arena->high_water = 0;
     arena->size = buf_size;
+    arena->committed = buf_size;
+    arena->commit_granularity = ARENA_COMMIT_GRANULARITY;
+    arena->page_size = (size_t)sysconf(_SC_PAGESIZE);
+    arena->page_kind = ARENA_PAGE_KIND_DEFAULT;
+    arena->flags = ARENA_FLAG_NONE;
+    arena->temp_depth = 0;
+}
+
+// over-reserves and trims so the range starts on a huge page boundary
+static void* reserve_huge_aligned(size_t reserve_size) {
+    const size_t padded = reserve_size + ARENA_HUGE_PAGE_SIZE;
+    u8 *const raw = mmap(NULL, padded, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (raw == MAP_FAILED) {
+        return MAP_FAILED;
+    }
+    u8 *const aligned = (u8*)align_forward((uintptr_t)raw, ARENA_HUGE_PAGE_SIZE);
+    if (aligned != raw) {
+        munmap(raw, aligned - raw);
+    }
+    const size_t tail = (raw + padded) - (aligned + reserve_size);
+    if (tail) {
+        munmap(aligned + reserve_size, tail);
+    }
+    return aligned;
+}
+
+bool arena_init_virtual(Arena *arena, size_t reserve_size, u32 flags) {
+    MY_ASSERT(reserve_size);
+    void *buf = MAP_FAILED;
+    ArenaPageKind page_kind = ARENA_PAGE_KIND_DEFAULT;
+    size_t granularity = ARENA_COMMIT_GRANULARITY;
+    if (flags & ARENA_FLAG_HUGE_PAGES) {
+        granularity = ARENA_HUGE_PAGE_SIZE;
+        reserve_size = align_forward(reserve_size, ARENA_HUGE_PAGE_SIZE);
+        // hugetlb pages come from a preallocated pool and are claimed at mmap,
+        // so only bounded arenas use it; bigger ones stay commit on demand
+        if (reserve_size <= ARENA_HUGETLB_MAX_RESERVE) {
+            buf = mmap(NULL, reserve_size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        }
+        if (buf != MAP_FAILED) {
+            page_kind = ARENA_PAGE_KIND_HUGETLB;
+        } else {
+            buf = reserve_huge_aligned(reserve_size);
+            if (buf != MAP_FAILED && madvise(buf, reserve_size, MADV_HUGEPAGE) == 0) {
+                page_kind = ARENA_PAGE_KIND_TRANSPARENT_HUGE;
+            }
+        }
+    } else {
+        reserve_size = align_forward(reserve_size, ARENA_COMMIT_GRANULARITY);
+        buf = mmap(NULL, reserve_size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    }
+    if (buf == MAP_FAILED) {
+        return false;
+    }
+    arena->buf = buf;
+    arena->prev_offset = 0;
+    arena->offset = 0;
+    arena->high_water = 0;
+    arena->size = reserve_size;
+    arena->committed = 0;
+    arena->commit_granularity = granularity;
+    arena->page_size = page_kind == ARENA_PAGE_KIND_DEFAULT ? (size_t)sysconf(_SC_PAGESIZE) : ARENA_HUGE_PAGE_SIZE;
+    arena->page_kind = page_kind;
+    arena->flags = flags | ARENA_FLAG_VIRTUAL;
+    arena->temp_depth = 0;
+    return true;
+}
+
+void arena_release(Arena *arena) {
+    if (arena->flags & ARENA_FLAG_VIRTUAL) {
+        munmap(arena->buf, arena->size);
+    }
+    *arena = (Arena) { 0 };
+}
+
+static bool arena_commit(Arena *arena, size_t end) {
+    if (end <= arena->committed) {
+        return true;
+    }
+    if (!(arena->flags & ARENA_FLAG_VIRTUAL)) {
+        return false;
+    }
+    // a DoubleStack pulls size down to arbitrary offsets, mprotect needs whole granules
+    const size_t limit = align_forward(arena->size, arena->commit_granularity);
+    size_t new_committed = align_forward(end, arena->commit_granularity);
+    if (new_committed > limit) {
+        new_committed = limit;
+    }
+    if (mprotect(arena->buf + arena->committed, new_committed - arena->committed, PROT_READ | PROT_WRITE) != 0) {
+        return false;
+    }
+    arena->committed = new_committed;
+    return true;
 }
 
 void arena_clear(Arena *arena) {
+    MY_ASSERT(arena->temp_depth == 0 && "Clearing an arena with live temps");
     arena->offset = 0;
     arena->prev_offset = 0;
+    if ((arena->flags & ARENA_FLAG_DECOMMIT_ON_CLEAR) && arena->committed) {
+        madvise(arena->buf, arena->committed, MADV_DONTNEED);
+        mprotect(arena->buf, arena->committed, PROT_NONE);
+        arena->committed = 0;
+    }
 }
 
 void* arena_alloc(Arena *arena, size_t size, size_t alignment) {
     MY_ASSERT(is_power_of_two(alignment));
-    arena->prev_offset = arena->offset;
-    u32 offset = align_forward(arena->offset, alignment);
-    if (arena->size - offset < size) {
+    size_t offset = align_forward((uintptr_t)arena->buf + arena->offset, alignment) - (uintptr_t)arena->buf;
+    if (offset > arena->size || arena->size - offset < size) {
+        return NULL;
+    }
+    if (!arena_commit(arena, offset + size)) {
         return NULL;
     }
+    arena->prev_offset = offset;
     arena->offset = offset + size;
+    if (arena->offset > arena->high_water) {
+        arena->high_water = arena->offset;
+    }
     return arena->buf + offset;
 }
 
 void* arena_realloc(Arena *arena, void *old_mem, size_t old_size, size_t new_size, size_t alignment) {
     MY_ASSERT(is_power_of_two(alignment));
 
+    if (old_mem == NULL || old_size == 0) {
+        return arena_alloc(arena, new_size, alignment);
+    }
+
 	if ((u8*)old_mem < arena->buf || (u8*)old_mem > (arena->buf + arena->size)) {
         UNREACHABLE("Out of bounds of the arena");
         return NULL;
 	}
 
-    if (old_mem == NULL || old_size == 0) {
-		return arena_alloc(arena, new_size, alignment);
-	}
-
     if (old_mem == arena->buf + arena->prev_offset) {
-        arena->offset += new_size - old_size;
+        const size_t end = arena->prev_offset + new_size;
+        if (end > arena->size || !arena_commit(arena, end)) {
+            return NULL;
+        }
+        arena->offset = end;
+        if (end > arena->high_water) {
+            arena->high_water = end;
+        }
         return old_mem;
     }
     void *ret_val = arena_alloc(arena, new_size, alignment);
-    u32 copy_size = old_size < new_size ? old_size : new_size;
+    if (ret_val == NULL) {
+        return NULL;
+    }
+    size_t copy_size = old_size < new_size ? old_size : new_size;
     memmove(ret_val, old_mem, copy_size);
     return ret_val;
 }
 
+ArenaTemp arena_temp_begin(Arena *arena) {
+    arena->temp_depth++;
+    const ArenaTemp temp = {
+        .arena = arena,
+        .offset = arena->offset,
+        .prev_offset = arena->prev_offset,
+        .depth = arena->temp_depth,
+    };
+    // a block from before the temp must not grow in place, temp_end would
+    // hand its grown tail out again; no block starts at the current offset
+    arena->prev_offset = arena->offset;
+    return temp;
+}
+
+void arena_temp_end(ArenaTemp temp) {
+    Arena *const arena = temp.arena;
+    MY_ASSERT(arena->temp_depth == temp.depth && "ArenaTemp ended out of order");
+    MY_ASSERT(arena->offset >= temp.offset);
+    arena->temp_depth--;
+    arena->offset = temp.offset;
+    arena->prev_offset = temp.prev_offset;
+}
+
+static thread_local Arena scratch_arenas[ARENA_SCRATCH_COUNT];
+
+ArenaTemp arena_scratch_begin(const Arena *conflict) {
+    for (u32 i=0; i<ARENA_SCRATCH_COUNT; i++) {
+        Arena *const scratch = &scratch_arenas[i];
+        if (scratch == conflict) {
+            continue;
+        }
+        if (!scratch->buf && !arena_init_virtual(scratch, ARENA_SCRATCH_RESERVE, ARENA_FLAG_NONE)) {
+            UNREACHABLE("Failed to reserve scratch arena");
+        }
+        return arena_temp_begin(scratch);
+    }
+    UNREACHABLE("No scratch arena left");
+    return (ArenaTemp) { 0 };
+}
+
+size_t arena_scratch_high_water(void) {
+    size_t high_water = 0;
+    for (u32 i=0; i<ARENA_SCRATCH_COUNT; i++) {
+        if (scratch_arenas[i].high_water > high_water) {
+            high_water = scratch_arenas[i].high_water;
+        }
+    }
+    return high_water;
+}
@@ -0,0 +1,139 @@
+#include "double_stack.h"
+
+#include <string.h>
+#include <sys/mman.h>
+
+void double_stack_init(DoubleStack *stack, u8 *buf, size_t buf_size) {
+    arena_init(&stack->persistent, buf, buf_size);
+    stack->capacity = buf_size;
+    stack->transient_committed = 0;
+}
+
+bool double_stack_init_virtual(DoubleStack *stack, size_t reserve_size, u32 flags) {
+    // the ends can share a commit granule, decommitting one would zero the other
+    MY_ASSERT(!(flags & ARENA_FLAG_DECOMMIT_ON_CLEAR));
+    if (!arena_init_virtual(&stack->persistent, reserve_size, flags)) {
+        return false;
+    }
+    stack->capacity = stack->persistent.size;
+    stack->transient_committed = stack->capacity;
+    return true;
+}
+
+void double_stack_release(DoubleStack *stack) {
+    // arena_release unmaps persistent.size bytes
+    stack->persistent.size = stack->capacity;
+    arena_release(&stack->persistent);
+    *stack = (DoubleStack) { 0 };
+}
+
+void double_stack_clear(DoubleStack *stack) {
+    arena_clear(&stack->persistent);
+    double_stack_transient_clear(stack);
+}
+
+size_t double_stack_remaining(const DoubleStack *stack) {
+    return stack->persistent.size - stack->persistent.offset;
+}
+
+// commits downward from transient_committed to cover offset
+static bool commit_transient(DoubleStack *stack, size_t offset) {
+    Arena *const low = &stack->persistent;
+    if (offset >= stack->transient_committed) {
+        return true;
+    }
+    const size_t new_committed = align_backward(offset, low->commit_granularity);
+    if (mprotect(low->buf + new_committed, stack->transient_committed - new_committed, PROT_READ | PROT_WRITE) != 0) {
+        return false;
+    }
+    stack->transient_committed = new_committed;
+    return true;
+}
+
+// address of a block of size bytes that ends at end, 0 if it would cross the persistent end
+static uintptr_t place_transient(const DoubleStack *stack, uintptr_t end, size_t size, size_t alignment) {
+    const uintptr_t floor = (uintptr_t)stack->persistent.buf + stack->persistent.offset;
+    if (end < floor || end - floor < size) {
+        return 0;
+    }
+    const uintptr_t addr = align_backward(end - size, alignment);
+    return addr < floor ? 0 : addr;
+}
+
+void* double_stack_transient_alloc(DoubleStack *stack, size_t size, size_t alignment) {
+    Arena *const low = &stack->persistent;
+    const uintptr_t addr = place_transient(stack, (uintptr_t)low->buf + low->size, size, alignment);
+    if (!addr) {
+        return NULL;
+    }
+    const size_t offset = addr - (uintptr_t)low->buf;
+    if (!commit_transient(stack, offset)) {
+        return NULL;
+    }
+    low->size = offset;
+    return (void*)addr;
+}
+
+void* double_stack_transient_realloc(DoubleStack *stack, void *old_mem, size_t old_size, size_t new_size, size_t alignment) {
+    Arena *const low = &stack->persistent;
+    if (old_mem == NULL || old_size == 0) {
+        return double_stack_transient_alloc(stack, new_size, alignment);
+    }
+    if ((u8*)old_mem < low->buf + low->size || (u8*)old_mem >= low->buf + stack->capacity) {
+        UNREACHABLE("Out of bounds of the transient end");
+        return NULL;
+    }
+    const size_t copy_size = old_size < new_size ? old_size : new_size;
+    if ((u8*)old_mem == low->buf + low->size) {
+        // topmost block: keep its end and slide the start, the ranges overlap
+        const uintptr_t addr = place_transient(stack, (uintptr_t)old_mem + old_size, new_size, alignment);
+        if (!addr) {
+            return NULL;
+        }
+        const size_t offset = addr - (uintptr_t)low->buf;
+        if (!commit_transient(stack, offset)) {
+            return NULL;
+        }
+        memmove((void*)addr, old_mem, copy_size);
+        low->size = offset;
+        return (void*)addr;
+    }
+    void *const ret_val = double_stack_transient_alloc(stack, new_size, alignment);
+    if (ret_val == NULL) {
+        return NULL;
+    }
+    memcpy(ret_val, old_mem, copy_size);
+    return ret_val;
+}
+
+void double_stack_transient_free(DoubleStack *stack, void *mem, size_t size) {
+    Arena *const low = &stack->persistent;
+    // alignment padding above the block is only reclaimed by a rollback
+    if ((u8*)mem == low->buf + low->size) {
+        low->size += size;
+    }
+}
+
+void double_stack_transient_clear(DoubleStack *stack) {
+    stack->persistent.size = stack->capacity;
+}
+
+DoubleStackMarker double_stack_marker(const DoubleStack *stack, DoubleStackEnd end) {
+    const Arena *const low = &stack->persistent;
+    if (end == DOUBLE_STACK_PERSISTENT) {
+        return (DoubleStackMarker) { .end = end, .offset = low->offset, .prev_offset = low->prev_offset };
+    }
+    return (DoubleStackMarker) { .end = end, .offset = low->size };
+}
+
+void double_stack_rollback(DoubleStack *stack, DoubleStackMarker marker) {
+    Arena *const low = &stack->persistent;
+    if (marker.end == DOUBLE_STACK_PERSISTENT) {
+        MY_ASSERT(marker.offset <= low->offset && "Persistent marker is above the top");
+        low->offset = marker.offset;
+        low->prev_offset = marker.prev_offset;
+    } else {
+        MY_ASSERT(marker.offset >= low->size && marker.offset <= stack->capacity && "Transient marker is below the top");
+        low->size = marker.offset;
+    }
+}
@@ -0,0 +1,58 @@
+#include "frame_arenas.h"
+
+bool frame_arenas_init(FrameArenas *ring, AllocatorPoly backing, size_t arena_size, u32 depth) {
+    MY_ASSERT(depth && depth <= FRAME_ARENAS_MAX_DEPTH);
+    *ring = (FrameArenas) { .depth = depth, .current = depth - 1 };
+    for (u32 i=0; i<depth; i++) {
+        u8 *const buf = allocator_poly_alloc(backing, arena_size, alignof(max_align_t));
+        if (!buf) {
+            return false;
+        }
+        arena_init(&ring->arenas[i], buf, arena_size);
+    }
+    return true;
+}
+
+void frame_arenas_destroy(FrameArenas *ring) {
+    for (u32 i=0; i<ring->depth; i++) {
+        if (ring->fences[i]) {
+            glDeleteSync(ring->fences[i]);
+            ring->fences[i] = NULL;
+        }
+    }
+}
+
+Arena* frame_arenas_begin(FrameArenas *ring) {
+    ring->current = (ring->current + 1) % ring->depth;
+    GLsync const fence = ring->fences[ring->current];
+    if (fence) {
+        GLenum status = glClientWaitSync(fence, 0, 0);
+        if (status == GL_TIMEOUT_EXPIRED) {
+            ring->stall_cnt++;
+            do {
+                status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000 * 1000);
+            } while (status == GL_TIMEOUT_EXPIRED);
+        }
+        MY_ASSERT(status != GL_WAIT_FAILED);
+        glDeleteSync(fence);
+        ring->fences[ring->current] = NULL;
+    }
+    Arena *const arena = &ring->arenas[ring->current];
+    arena_clear(arena);
+    return arena;
+}
+
+void frame_arenas_end(FrameArenas *ring) {
+    MY_ASSERT(!ring->fences[ring->current]);
+    ring->fences[ring->current] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+size_t frame_arenas_high_water(const FrameArenas *ring) {
+    size_t high_water = 0;
+    for (u32 i=0; i<ring->depth; i++) {
+        if (ring->arenas[i].high_water > high_water) {
+            high_water = ring->arenas[i].high_water;
+        }
+    }
+    return high_water;
+}
@@ -1,78 +1,1074 @@
 #include "gl.h"
 
+#include <string.h>
+
+#include "arena.h"
+#include "dyn_array.h"
+#include "gl_stream.h"
+#include "vertex_pack.h"
+
+enum { GL_MESH_SLOT_NONE = UINT32_MAX };
+
+enum { GL_POOL_INITIAL_VERTS = 64 * 1024 };
+enum { GL_POOL_INITIAL_INDICES = 3 * GL_POOL_INITIAL_VERTS };
+
+// a frame of 64k instances and their draw commands
+enum { GL_STREAM_REGION_SIZE = 8 * 1024 * 1024 };
+
+typedef struct MeshSlot {
+    u32 generation;
+    u32 next_free;
+} MeshSlot;
+
+// span of elements in a shared buffer
+typedef struct GlRange {
+    u32 offset;
+    u32 size;
+} GlRange;
+
+DYN_ARRAY_DEFINE(GlRangeArray, gl_range_array, GlRange)
+
+// shared buffers of every vertex format with the same layout, the free
+// lists are sorted by offset
+typedef struct GlVertexPool {
+    const GlVertexLayout *layout;
+    GLuint vao;
+    GLuint position_vao;
+    GLuint vbos[GL_VERTEX_STREAM_COUNT];
+    GLuint ebo;
+    u32 vert_cap;
+    u32 index_cap;
+    GlRangeArray free_verts;
+    GlRangeArray free_indices;
+    // of the pool's GlVertexFormatBlock in gl_vertex_format_buffer
+    u32 format_block_offset;
+} GlVertexPool;
+
+AllocatorPoly gl_alloc;
+
 Mesh *gl_meshes = NULL;
 u32 gl_meshes_size = 0;
 u32 gl_meshes_cap = 0;
 
-GLuint *gl_vaos = NULL;
+MeshSlot *gl_mesh_slots = NULL;
+u32 gl_mesh_free_head = GL_MESH_SLOT_NONE;
+u32 gl_mesh_free_cnt = 0;
+
+// bytes of a vertex struct that go to the position stream
+#define GL_VERTEX_POSITION_SIZE(STRUCT) sizeof(((STRUCT*)0)->coord)
+#define GL_VERTEX_ATTRIB_IS_POSITION(STRUCT, MEMBER) (offsetof(STRUCT, MEMBER) < GL_VERTEX_POSITION_SIZE(STRUCT))
+
+#define GL_VERTEX_ATTRIB_DESC(LOCATION, COMPONENTS, TYPE, MODE, STRUCT, MEMBER)\
+    {\
+        .location = LOCATION,\
+        .components = COMPONENTS,\
+        .type = TYPE,\
+        .mode = MODE,\
+        .stream = GL_VERTEX_ATTRIB_IS_POSITION(STRUCT, MEMBER) ? GL_VERTEX_STREAM_POSITION : GL_VERTEX_STREAM_ATTRIBS,\
+        .offset = offsetof(STRUCT, MEMBER) - (GL_VERTEX_ATTRIB_IS_POSITION(STRUCT, MEMBER) ? 0 : GL_VERTEX_POSITION_SIZE(STRUCT)),\
+    },
+#define GL_VERTEX_FORMAT_ATTRIBS(NAME, STRUCT, ATTRIBS_X, ...)\
+    static const GlVertexAttrib gl_vertex_attribs_##NAME[] = { ATTRIBS_X(GL_VERTEX_ATTRIB_DESC) };
+GL_VERTEX_FORMATS_X(GL_VERTEX_FORMAT_ATTRIBS)
+#undef GL_VERTEX_FORMAT_ATTRIBS
+#undef GL_VERTEX_ATTRIB_DESC
+
+#define GL_VERTEX_FORMAT_LAYOUT(NAME, STRUCT, ATTRIBS_X, ENCODE, BOUNDS_RELATIVE, OCT_NORMALS)\
+    [GL_VERTEX_FORMAT_##NAME] = {\
+        .name = #NAME,\
+        .attribs = gl_vertex_attribs_##NAME,\
+        .attrib_cnt = ARRAY_LEN(gl_vertex_attribs_##NAME),\
+        .stride = sizeof(STRUCT),\
+        .stream_strides = {\
+            [GL_VERTEX_STREAM_POSITION] = GL_VERTEX_POSITION_SIZE(STRUCT),\
+            [GL_VERTEX_STREAM_ATTRIBS] = sizeof(STRUCT) - GL_VERTEX_POSITION_SIZE(STRUCT),\
+        },\
+        .encode = ENCODE,\
+        .bounds_relative = BOUNDS_RELATIVE,\
+        .oct_normals = OCT_NORMALS,\
+    },
+static const GlVertexLayout gl_vertex_layouts[GL_VERTEX_FORMAT_COUNT] = {
+    GL_VERTEX_FORMATS_X(GL_VERTEX_FORMAT_LAYOUT)
+};
+#undef GL_VERTEX_FORMAT_LAYOUT
+#undef GL_VERTEX_ATTRIB_IS_POSITION
+#undef GL_VERTEX_POSITION_SIZE
 
-GLuint *gl_vbos_ebos;
+GlVertexPool gl_pools[GL_VERTEX_FORMAT_COUNT];
+u32 gl_pool_cnt = 0;
+// formats with the same attributes point at the same pool
+GlVertexPool *gl_format_pools[GL_VERTEX_FORMAT_COUNT];
+// GlVertexFormatBlock of every pool, gl_uniform_alignment apart
+GLuint gl_vertex_format_buffer = 0;
 
-void gl_init(u32 max_mesh_cnt, Mesh meshes_buf[static max_mesh_cnt], GLuint vaos_ebos_buf[static max_mesh_cnt * 2], GLuint vbo_sets_buf[static max_mesh_cnt]) {
-    glEnable(GL_DEPTH_TEST);
-    gl_meshes = meshes_buf;
+// batch submission, shared by every format
+bool gl_multi_draw_indirect_supported = false;
+bool gl_multi_draw_indirect = false;
+// instances and indirect commands of every batch in the frame
+GlStream gl_stream;
+GLuint gl_instance_texture = 0;
+// 0, 1, 2, ... read with divisor 1, base_instance or the attribute offset selects the first
+GLuint gl_instance_id_buffer = 0;
+u32 gl_instance_id_cap = 0;
+// glBindBufferRange on GL_UNIFORM_BUFFER needs offsets aligned to this
+u32 gl_uniform_alignment = 1;
+
+// shadow of the GL state changed through the gl_bind_*/gl_set_* wrappers,
+// GL_STATE_UNKNOWN until the first call sets it
+#define GL_STATE_UNKNOWN UINT32_MAX
+
+enum { GL_STATE_TEXTURE_UNITS = 16 };
+enum { GL_STATE_UNIFORM_BINDINGS = 16 };
+
+typedef enum GlStateBufferTarget {
+    GL_STATE_BUFFER_ARRAY = 0,
+    GL_STATE_BUFFER_COPY_READ,
+    GL_STATE_BUFFER_COPY_WRITE,
+    GL_STATE_BUFFER_TEXTURE,
+    GL_STATE_BUFFER_DRAW_INDIRECT,
+    GL_STATE_BUFFER_UNIFORM,
+    GL_STATE_BUFFER_COUNT,
+} GlStateBufferTarget;
+
+typedef enum GlStateTextureTarget {
+    GL_STATE_TEXTURE_2D = 0,
+    GL_STATE_TEXTURE_BUFFER,
+    GL_STATE_TEXTURE_COUNT,
+} GlStateTextureTarget;
+
+typedef enum GlStateCap {
+    GL_STATE_CAP_DEPTH_TEST = 0,
+    GL_STATE_CAP_BLEND,
+    GL_STATE_CAP_CULL_FACE,
+    GL_STATE_CAP_COUNT,
+} GlStateCap;
+
+typedef struct GlStateBufferRange {
+    GLuint buffer;
+    GLintptr offset;
+    GLsizeiptr size;
+} GlStateBufferRange;
+
+typedef struct GlState {
+    GLuint program;
+    GLuint vao;
+    GLuint buffers[GL_STATE_BUFFER_COUNT];
+    GlStateBufferRange uniform_ranges[GL_STATE_UNIFORM_BINDINGS];
+    u32 active_texture;
+    GLuint textures[GL_STATE_TEXTURE_UNITS][GL_STATE_TEXTURE_COUNT];
+    // 0 or 1, GL_STATE_UNKNOWN
+    u32 caps[GL_STATE_CAP_COUNT];
+    // 0 or 1, GL_STATE_UNKNOWN
+    u32 depth_mask;
+    GLenum blend_src;
+    GLenum blend_dst;
+    GLint viewport[4];
+    bool viewport_known;
+    GlStateStats stats;
+} GlState;
+
+static GlState gl_state;
+
+static void gl_state_reset(void) {
+    gl_state = (GlState) {
+        .program = GL_STATE_UNKNOWN,
+        .vao = GL_STATE_UNKNOWN,
+        .active_texture = GL_STATE_UNKNOWN,
+        .depth_mask = GL_STATE_UNKNOWN,
+        .blend_src = GL_STATE_UNKNOWN,
+        .blend_dst = GL_STATE_UNKNOWN,
+    };
+    memset(gl_state.buffers, 0xff, sizeof(gl_state.buffers));
+    for (u32 i=0; i<GL_STATE_UNIFORM_BINDINGS; i++) {
+        gl_state.uniform_ranges[i].buffer = GL_STATE_UNKNOWN;
+    }
+    memset(gl_state.textures, 0xff, sizeof(gl_state.textures));
+    memset(gl_state.caps, 0xff, sizeof(gl_state.caps));
+}
+
+// true when the call has to be issued, cached is updated to value
+static bool gl_state_set(u32 *cached, u32 value) {
+    if (*cached == value) {
+        gl_state.stats.elided++;
+        return false;
+    }
+    *cached = value;
+    gl_state.stats.issued++;
+    return true;
+}
+
+static GlStateBufferTarget gl_state_buffer_target(GLenum target) {
+    switch (target) {
+        case GL_ARRAY_BUFFER: return GL_STATE_BUFFER_ARRAY;
+        case GL_COPY_READ_BUFFER: return GL_STATE_BUFFER_COPY_READ;
+        case GL_COPY_WRITE_BUFFER: return GL_STATE_BUFFER_COPY_WRITE;
+        case GL_TEXTURE_BUFFER: return GL_STATE_BUFFER_TEXTURE;
+        case GL_DRAW_INDIRECT_BUFFER: return GL_STATE_BUFFER_DRAW_INDIRECT;
+        case GL_UNIFORM_BUFFER: return GL_STATE_BUFFER_UNIFORM;
+        default:
+            // GL_ELEMENT_ARRAY_BUFFER is VAO state, bind it with glBindBuffer after gl_bind_vao
+            UNREACHABLE("Untracked buffer target");
+            return GL_STATE_BUFFER_ARRAY;
+    }
+}
+
+static GlStateTextureTarget gl_state_texture_target(GLenum target) {
+    switch (target) {
+        case GL_TEXTURE_2D: return GL_STATE_TEXTURE_2D;
+        case GL_TEXTURE_BUFFER: return GL_STATE_TEXTURE_BUFFER;
+        default:
+            UNREACHABLE("Untracked texture target");
+            return GL_STATE_TEXTURE_2D;
+    }
+}
+
+static GlStateCap gl_state_cap(GLenum cap) {
+    switch (cap) {
+        case GL_DEPTH_TEST: return GL_STATE_CAP_DEPTH_TEST;
+        case GL_BLEND: return GL_STATE_CAP_BLEND;
+        case GL_CULL_FACE: return GL_STATE_CAP_CULL_FACE;
+        default:
+            UNREACHABLE("Untracked capability");
+            return GL_STATE_CAP_DEPTH_TEST;
+    }
+}
+
+void gl_use_program(GLuint prog) {
+    if (gl_state_set(&gl_state.program, prog)) {
+        glUseProgram(prog);
+    }
+}
+
+void gl_bind_vao(GLuint vao) {
+    if (gl_state_set(&gl_state.vao, vao)) {
+        glBindVertexArray(vao);
+    }
+}
+
+void gl_bind_buffer(GLenum target, GLuint buffer) {
+    if (gl_state_set(&gl_state.buffers[gl_state_buffer_target(target)], buffer)) {
+        glBindBuffer(target, buffer);
+    }
+}
+
+void gl_bind_buffer_range(GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size) {
+    MY_ASSERT(target == GL_UNIFORM_BUFFER && "Only uniform ranges are tracked");
+    MY_ASSERT(index < GL_STATE_UNIFORM_BINDINGS);
+    GlStateBufferRange *const cached = &gl_state.uniform_ranges[index];
+    if (cached->buffer == buffer && cached->offset == offset && cached->size == size) {
+        gl_state.stats.elided++;
+        return;
+    }
+    *cached = (GlStateBufferRange) { .buffer = buffer, .offset = offset, .size = size };
+    // the call also sets the generic binding
+    gl_state.buffers[gl_state_buffer_target(target)] = buffer;
+    gl_state.stats.issued++;
+    glBindBufferRange(target, index, buffer, offset, size);
+}
+
+void gl_bind_texture(u32 unit, GLenum target, GLuint texture) {
+    MY_ASSERT(unit < GL_STATE_TEXTURE_UNITS);
+    GLuint *const cached = &gl_state.textures[unit][gl_state_texture_target(target)];
+    if (*cached == texture) {
+        gl_state.stats.elided++;
+        return;
+    }
+    // one logical bind, the unit switch it may need is not counted on its own
+    if (gl_state.active_texture != unit) {
+        gl_state.active_texture = unit;
+        glActiveTexture(GL_TEXTURE0 + unit);
+    }
+    *cached = texture;
+    gl_state.stats.issued++;
+    glBindTexture(target, texture);
+}
+
+void gl_set_capability(GLenum cap, bool enabled) {
+    if (!gl_state_set(&gl_state.caps[gl_state_cap(cap)], enabled)) {
+        return;
+    }
+    if (enabled) {
+        glEnable(cap);
+    } else {
+        glDisable(cap);
+    }
+}
+
+void gl_set_depth_mask(bool write) {
+    if (gl_state_set(&gl_state.depth_mask, write)) {
+        glDepthMask(write ? GL_TRUE : GL_FALSE);
+    }
+}
+
+void gl_set_blend_func(GLenum src, GLenum dst) {
+    if (gl_state.blend_src == src && gl_state.blend_dst == dst) {
+        gl_state.stats.elided++;
+        return;
+    }
+    gl_state.blend_src = src;
+    gl_state.blend_dst = dst;
+    gl_state.stats.issued++;
+    glBlendFunc(src, dst);
+}
+
+void gl_set_viewport(GLint x, GLint y, GLsizei width, GLsizei height) {
+    const GLint viewport[4] = { x, y, width, height };
+    if (gl_state.viewport_known && memcmp(gl_state.viewport, viewport, sizeof(viewport)) == 0) {
+        gl_state.stats.elided++;
+        return;
+    }
+    memcpy(gl_state.viewport, viewport, sizeof(viewport));
+    gl_state.viewport_known = true;
+    gl_state.stats.issued++;
+    glViewport(x, y, width, height);
+}
+
+// GL resets the bindings of a deleted name to 0
+void gl_delete_buffers(GLsizei n, const GLuint *buffers) {
+    for (GLsizei i=0; i<n; i++) {
+        for (u32 target=0; target<GL_STATE_BUFFER_COUNT; target++) {
+            if (gl_state.buffers[target] == buffers[i]) {
+                gl_state.buffers[target] = 0;
+            }
+        }
+        for (u32 index=0; index<GL_STATE_UNIFORM_BINDINGS; index++) {
+            if (gl_state.uniform_ranges[index].buffer == buffers[i]) {
+                gl_state.uniform_ranges[index] = (GlStateBufferRange) { 0 };
+            }
+        }
+    }
+    glDeleteBuffers(n, buffers);
+}
+
+void gl_delete_textures(GLsizei n, const GLuint *textures) {
+    for (GLsizei i=0; i<n; i++) {
+        for (u32 unit=0; unit<GL_STATE_TEXTURE_UNITS; unit++) {
+            for (u32 target=0; target<GL_STATE_TEXTURE_COUNT; target++) {
+                if (gl_state.textures[unit][target] == textures[i]) {
+                    gl_state.textures[unit][target] = 0;
+                }
+            }
+        }
+    }
+    glDeleteTextures(n, textures);
+}
+
+const GlStateStats* gl_get_state_stats(void) {
+    return &gl_state.stats;
+}
+
+static void* gl_grow_array(void *arr, size_t elem_size, size_t elem_alignment, u32 old_cap, u32 new_cap) {
+    return allocator_poly_realloc(gl_alloc, arr, elem_size * old_cap, elem_size * new_cap, elem_alignment);
+}
+
+static bool gl_meshes_reserve(u32 needed) {
+    if (needed <= gl_meshes_cap) {
+        return true;
+    }
+    u32 new_cap = gl_meshes_cap ? gl_meshes_cap : 16;
+    while (new_cap < needed) {
+        new_cap *= 2;
+    }
+    Mesh *const meshes = gl_grow_array(gl_meshes, sizeof(Mesh), alignof(Mesh), gl_meshes_cap, new_cap);
+    if (!meshes) return false;
+    gl_meshes = meshes;
+    MeshSlot *const slots = gl_grow_array(gl_mesh_slots, sizeof(MeshSlot), alignof(MeshSlot), gl_meshes_cap, new_cap);
+    if (!slots) return false;
+    gl_mesh_slots = slots;
+    gl_meshes_cap = new_cap;
+    return true;
+}
+
+// first fit, the remainder of the range stays free
+static bool gl_range_alloc(GlRangeArray *free_ranges, u32 size, u32 *offset) {
+    for (u32 i=0; i<free_ranges->size; i++) {
+        GlRange *const range = &free_ranges->data[i];
+        if (range->size < size) {
+            continue;
+        }
+        *offset = range->offset;
+        range->offset += size;
+        range->size -= size;
+        if (!range->size) {
+            memmove(range, range + 1, sizeof(GlRange) * (free_ranges->size - i - 1));
+            free_ranges->size--;
+        }
+        return true;
+    }
+    return false;
+}
+
+// merges with the neighbours, false if a new entry was needed and did not fit
+static bool gl_range_free(GlRangeArray *free_ranges, u32 offset, u32 size) {
+    u32 lo = 0;
+    u32 hi = free_ranges->size;
+    while (lo < hi) {
+        const u32 mid = (lo + hi) / 2;
+        if (free_ranges->data[mid].offset < offset) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    GlRange *const prev = lo ? &free_ranges->data[lo - 1] : NULL;
+    GlRange *const next = lo < free_ranges->size ? &free_ranges->data[lo] : NULL;
+    MY_ASSERT((!prev || prev->offset + prev->size <= offset) && (!next || offset + size <= next->offset) && "Double free of a buffer range");
+    const bool merge_prev = prev && prev->offset + prev->size == offset;
+    const bool merge_next = next && offset + size == next->offset;
+    if (merge_prev && merge_next) {
+        prev->size += size + next->size;
+        memmove(next, next + 1, sizeof(GlRange) * (free_ranges->size - lo - 1));
+        free_ranges->size--;
+    } else if (merge_prev) {
+        prev->size += size;
+    } else if (merge_next) {
+        next->offset = offset;
+        next->size += size;
+    } else {
+        if (!gl_range_array_push(free_ranges)) {
+            return false;
+        }
+        GlRange *const slot = &free_ranges->data[lo];
+        memmove(slot + 1, slot, sizeof(GlRange) * (free_ranges->size - lo - 1));
+        *slot = (GlRange) { .offset = offset, .size = size };
+    }
+    return true;
+}
+
+const GlVertexLayout* gl_vertex_layout(GlVertexFormat format) {
+    MY_ASSERT(format < GL_VERTEX_FORMAT_COUNT);
+    return &gl_vertex_layouts[format];
+}
+
+bool gl_vertex_formats_share_pool(GlVertexFormat a, GlVertexFormat b) {
+    MY_ASSERT(a < GL_VERTEX_FORMAT_COUNT && b < GL_VERTEX_FORMAT_COUNT);
+    return gl_format_pools[a] == gl_format_pools[b];
+}
+
+bool gl_vertex_layouts_equal(const GlVertexLayout *a, const GlVertexLayout *b) {
+    if (a->stride != b->stride || a->attrib_cnt != b->attrib_cnt || a->oct_normals != b->oct_normals
+        || memcmp(a->stream_strides, b->stream_strides, sizeof(a->stream_strides))) {
+        return false;
+    }
+    for (u32 i=0; i<a->attrib_cnt; i++) {
+        const GlVertexAttrib *const x = &a->attribs[i];
+        const GlVertexAttrib *const y = &b->attribs[i];
+        if (x->location != y->location || x->components != y->components || x->type != y->type
+            || x->mode != y->mode || x->stream != y->stream || x->offset != y->offset) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// attribute pointers into the pool's stream buffers for the bound VAO
+static void gl_vertex_layout_setup(const GlVertexLayout *layout, const GLuint vbos[static GL_VERTEX_STREAM_COUNT], bool position_only) {
+    for (u32 i=0; i<layout->attrib_cnt; i++) {
+        const GlVertexAttrib *const attrib = &layout->attribs[i];
+        if (position_only && attrib->stream != GL_VERTEX_STREAM_POSITION) {
+            continue;
+        }
+        const u32 stride = layout->stream_strides[attrib->stream];
+        const void *const offset = (void*)(size_t)attrib->offset;
+        gl_bind_buffer(GL_ARRAY_BUFFER, vbos[attrib->stream]);
+        if (attrib->mode == GL_VERTEX_ATTRIB_INTEGER) {
+            glVertexAttribIPointer(attrib->location, attrib->components, attrib->type, stride, offset);
+        } else {
+            const GLboolean normalized = attrib->mode == GL_VERTEX_ATTRIB_NORMALIZED;
+            glVertexAttribPointer(attrib->location, attrib->components, attrib->type, normalized, stride, offset);
+        }
+        glEnableVertexAttribArray(attrib->location);
+    }
+}
+
+static u32 gl_index_size(GLenum index_type) {
+    return index_type == GL_UNSIGNED_SHORT ? sizeof(u16) : sizeof(GLuint);
+}
+
+// index ranges are allocated in GLuint sized units, 16-bit meshes round up
+static u32 gl_index_units(u32 cnt, GLenum index_type) {
+    return (cnt * gl_index_size(index_type) + sizeof(GLuint) - 1) / sizeof(GLuint);
+}
+
+// copies the old contents into a new, bigger buffer, the name changes
+static void gl_buffer_grow(GLuint *buf, size_t old_size, size_t new_size) {
+    GLuint new_buf;
+    glGenBuffers(1, &new_buf);
+    gl_bind_buffer(GL_COPY_WRITE_BUFFER, new_buf);
+    glBufferData(GL_COPY_WRITE_BUFFER, new_size, NULL, GL_STATIC_DRAW);
+    if (*buf) {
+        gl_bind_buffer(GL_COPY_READ_BUFFER, *buf);
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, old_size);
+        gl_delete_buffers(1, buf);
+    }
+    *buf = new_buf;
+}
+
+static bool gl_pool_grow_verts(GlVertexPool *pool, u32 needed) {
+    u32 new_cap = pool->vert_cap ? pool->vert_cap * 2 : GL_POOL_INITIAL_VERTS;
+    while (new_cap - pool->vert_cap < needed) {
+        new_cap *= 2;
+    }
+    if (!gl_range_free(&pool->free_verts, pool->vert_cap, new_cap - pool->vert_cap)) {
+        return false;
+    }
+    for (u32 stream=0; stream<GL_VERTEX_STREAM_COUNT; stream++) {
+        const u32 stride = pool->layout->stream_strides[stream];
+        if (stride) {
+            gl_buffer_grow(&pool->vbos[stream], (size_t)pool->vert_cap * stride, (size_t)new_cap * stride);
+        }
+    }
+    pool->vert_cap = new_cap;
+    // the attribute pointers captured the old buffers
+    gl_bind_vao(pool->vao);
+    gl_vertex_layout_setup(pool->layout, pool->vbos, false);
+    gl_bind_vao(pool->position_vao);
+    gl_vertex_layout_setup(pool->layout, pool->vbos, true);
+    return true;
+}
+
+static bool gl_pool_grow_indices(GlVertexPool *pool, u32 needed) {
+    u32 new_cap = pool->index_cap ? pool->index_cap * 2 : GL_POOL_INITIAL_INDICES;
+    while (new_cap - pool->index_cap < needed) {
+        new_cap *= 2;
+    }
+    if (!gl_range_free(&pool->free_indices, pool->index_cap, new_cap - pool->index_cap)) {
+        return false;
+    }
+    gl_buffer_grow(&pool->ebo, (size_t)pool->index_cap * sizeof(GLuint), (size_t)new_cap * sizeof(GLuint));
+    pool->index_cap = new_cap;
+    // the element binding is VAO state
+    gl_bind_vao(pool->vao);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, pool->ebo);
+    gl_bind_vao(pool->position_vao);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, pool->ebo);
+    return true;
+}
+
+static void gl_pool_setup_instance_id(GLuint vao) {
+    gl_bind_vao(vao);
+    gl_bind_buffer(GL_ARRAY_BUFFER, gl_instance_id_buffer);
+    glVertexAttribIPointer(GL_INSTANCE_ID_ATTRIB, 1, GL_UNSIGNED_INT, sizeof(u32), 0);
+    glVertexAttribDivisor(GL_INSTANCE_ID_ATTRIB, 1);
+    glEnableVertexAttribArray(GL_INSTANCE_ID_ATTRIB);
+}
+
+// splits cnt vertex structs of the pool's layout into its streams
+static void gl_pool_upload_verts(GlVertexPool *pool, u32 base_vertex, const void *src, u32 cnt) {
+    const GlVertexLayout *const layout = pool->layout;
+    ArenaTemp scratch = arena_scratch_begin(NULL);
+    u32 struct_offset = 0;
+    for (u32 stream=0; stream<GL_VERTEX_STREAM_COUNT; stream++) {
+        const u32 stride = layout->stream_strides[stream];
+        if (!stride) {
+            continue;
+        }
+        u8 *const dst = arena_alloc(scratch.arena, (size_t)cnt * stride, 16);
+        MY_ASSERT(dst);
+        for (u32 i=0; i<cnt; i++) {
+            memcpy(dst + (size_t)i * stride, (const u8*)src + (size_t)i * layout->stride + struct_offset, stride);
+        }
+        // the copy target leaves the VAO's element binding alone
+        gl_bind_buffer(GL_COPY_WRITE_BUFFER, pool->vbos[stream]);
+        glBufferSubData(GL_COPY_WRITE_BUFFER, (size_t)base_vertex * stride, (size_t)cnt * stride, dst);
+        struct_offset += stride;
+    }
+    arena_scratch_end(scratch);
+}
+
+static void gl_instance_ids_reserve(u32 cnt) {
+    if (cnt <= gl_instance_id_cap) {
+        return;
+    }
+    u32 new_cap = gl_instance_id_cap ? gl_instance_id_cap : 1024;
+    while (new_cap < cnt) {
+        new_cap *= 2;
+    }
+    ArenaTemp scratch = arena_scratch_begin(NULL);
+    u32 *const ids = ARENA_MAKE(scratch.arena, u32, new_cap);
+    MY_ASSERT(ids);
+    for (u32 i=0; i<new_cap; i++) {
+        ids[i] = i;
+    }
+    // same name, so the VAOs keep pointing at it
+    gl_bind_buffer(GL_COPY_WRITE_BUFFER, gl_instance_id_buffer);
+    glBufferData(GL_COPY_WRITE_BUFFER, sizeof(u32) * new_cap, ids, GL_STATIC_DRAW);
+    arena_scratch_end(scratch);
+    gl_instance_id_cap = new_cap;
+}
+
+// static, the blocks only depend on the layouts
+static void gl_vertex_format_blocks_init(void) {
+    const u32 stride = (sizeof(GlVertexFormatBlock) + gl_uniform_alignment - 1) / gl_uniform_alignment * gl_uniform_alignment;
+    ArenaTemp scratch = arena_scratch_begin(NULL);
+    u8 *const blocks = ARENA_MAKE(scratch.arena, u8, stride * gl_pool_cnt);
+    MY_ASSERT(blocks);
+    memset(blocks, 0, stride * gl_pool_cnt);
+    for (u32 i=0; i<gl_pool_cnt; i++) {
+        GlVertexPool *const pool = &gl_pools[i];
+        pool->format_block_offset = stride * i;
+        const GlVertexFormatBlock block = { .oct_normals = pool->layout->oct_normals };
+        memcpy(blocks + pool->format_block_offset, &block, sizeof(block));
+    }
+    glGenBuffers(1, &gl_vertex_format_buffer);
+    gl_bind_buffer(GL_COPY_WRITE_BUFFER, gl_vertex_format_buffer);
+    glBufferData(GL_COPY_WRITE_BUFFER, stride * gl_pool_cnt, blocks, GL_STATIC_DRAW);
+    arena_scratch_end(scratch);
+}
+
+static void gl_pool_bind_format_block(const GlVertexPool *pool) {
+    gl_bind_buffer_range(GL_UNIFORM_BUFFER, GL_VERTEX_FORMAT_BLOCK_BINDING, gl_vertex_format_buffer,
+                         pool->format_block_offset, sizeof(GlVertexFormatBlock));
+}
+
+GlError gl_init(AllocatorPoly alloc, u32 initial_mesh_cap) {
+    gl_state_reset();
+    gl_set_capability(GL_DEPTH_TEST, true);
+    gl_alloc = alloc;
+    gl_meshes = NULL;
     gl_meshes_size = 0;
-    gl_meshes_cap = max_mesh_cnt;
-    gl_vaos = vaos_ebos_buf;
-    gl_vbos_ebos = vbo_sets_buf;
+    gl_meshes_cap = 0;
+    gl_mesh_slots = NULL;
+    gl_mesh_free_head = GL_MESH_SLOT_NONE;
+    gl_mesh_free_cnt = 0;
+    if (!gl_meshes_reserve(initial_mesh_cap)) {
+        return GL_ERROR_OUT_OF_MEMORY;
+    }
+    gl_multi_draw_indirect_supported = GLEW_VERSION_4_3 || (GLEW_ARB_multi_draw_indirect && GLEW_ARB_base_instance);
+    gl_multi_draw_indirect = gl_multi_draw_indirect_supported;
+    // the whole stream is one texture buffer, keep it within the texel limit
+    GLint max_texels;
+    glGetIntegerv(GL_MAX_TEXTURE_BUFFER_SIZE, &max_texels);
+    size_t stream_size = (size_t)GL_STREAM_REGION_SIZE * GL_FRAMES_IN_FLIGHT;
+    if (stream_size > (size_t)max_texels * sizeof(f32) * 4) {
+        stream_size = (size_t)max_texels * sizeof(f32) * 4;
+    }
+    if (!gl_stream_init(&gl_stream, stream_size, GL_FRAMES_IN_FLIGHT)) {
+        return GL_ERROR_OUT_OF_MEMORY;
+    }
+    glGenBuffers(1, &gl_instance_id_buffer);
+    gl_instance_id_cap = 0;
+    gl_instance_ids_reserve(1);
+    glGenTextures(1, &gl_instance_texture);
+    gl_bind_texture(GL_INSTANCES_TEXTURE_UNIT, GL_TEXTURE_BUFFER, gl_instance_texture);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, gl_stream.buffer);
+    GLint uniform_alignment;
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &uniform_alignment);
+    gl_uniform_alignment = uniform_alignment > 0 ? uniform_alignment : 1;
+    gl_pool_cnt = 0;
+    for (u32 format=0; format<GL_VERTEX_FORMAT_COUNT; format++) {
+        const GlVertexLayout *const layout = &gl_vertex_layouts[format];
+        gl_format_pools[format] = NULL;
+        for (u32 i=0; i<gl_pool_cnt; i++) {
+            if (gl_vertex_layouts_equal(gl_pools[i].layout, layout)) {
+                gl_format_pools[format] = &gl_pools[i];
+                break;
+            }
+        }
+        if (gl_format_pools[format]) {
+            continue;
+        }
+        GlVertexPool *const pool = &gl_pools[gl_pool_cnt++];
+        gl_format_pools[format] = pool;
+        *pool = (GlVertexPool) { .layout = layout };
+        gl_range_array_init(&pool->free_verts, alloc);
+        gl_range_array_init(&pool->free_indices, alloc);
+        glGenVertexArrays(1, &pool->vao);
+        glGenVertexArrays(1, &pool->position_vao);
+        if (!gl_pool_grow_verts(pool, 0) || !gl_pool_grow_indices(pool, 0)) {
+            return GL_ERROR_OUT_OF_MEMORY;
+        }
+        gl_pool_setup_instance_id(pool->vao);
+        gl_pool_setup_instance_id(pool->position_vao);
+    }
+    gl_vertex_format_blocks_init();
+    return GL_ERROR_NONE;
 }
 
-void gl_mesh_init(u32 n, MeshHandle handle_buf[static n], Vertex *verts[static n], GLuint *indices[static n], u32 vert_cnts[static n], u32 indices_cnt[static n]) {
-    MY_ASSERT(gl_meshes && gl_vaos && gl_vbos_ebos);
-    GLint prev_vao;
-    glGetIntegerv(GL_VERTEX_ARRAY_BINDING, &prev_vao);
-    glGenVertexArrays(n, gl_vaos+gl_meshes_size);
-    glGenBuffers(n * 2, gl_vbos_ebos + gl_meshes_size * 2);
+void gl_deinit(void) {
+    gl_bind_vao(0);
+    for (u32 i=0; i<gl_pool_cnt; i++) {
+        GlVertexPool *const pool = &gl_pools[i];
+        glDeleteVertexArrays(1, &pool->vao);
+        glDeleteVertexArrays(1, &pool->position_vao);
+        for (u32 stream=0; stream<GL_VERTEX_STREAM_COUNT; stream++) {
+            if (pool->vbos[stream]) {
+                gl_delete_buffers(1, &pool->vbos[stream]);
+            }
+        }
+        gl_delete_buffers(1, &pool->ebo);
+        gl_range_array_free(&pool->free_verts);
+        gl_range_array_free(&pool->free_indices);
+        *pool = (GlVertexPool) { 0 };
+    }
+    gl_pool_cnt = 0;
+    gl_delete_textures(1, &gl_instance_texture);
+    gl_stream_destroy(&gl_stream);
+    gl_delete_buffers(1, &gl_instance_id_buffer);
+    gl_delete_buffers(1, &gl_vertex_format_buffer);
+    gl_instance_texture = 0;
+    gl_instance_id_buffer = 0;
+    gl_vertex_format_buffer = 0;
+    gl_instance_id_cap = 0;
+}
+
+GlError gl_mesh_init(u32 n, MeshHandle handle_buf[static n], Vertex *verts[static n], GLuint *indices[static n], u32 vert_cnts[static n], u32 indices_cnt[static n], const GlVertexFormat formats[static n]) {
+    MY_ASSERT(gl_alloc.vtable.alloc);
+    const u32 append_cnt = n > gl_mesh_free_cnt ? n - gl_mesh_free_cnt : 0;
+    if (!gl_meshes_reserve(gl_meshes_size + append_cnt)) {
+        return GL_ERROR_OUT_OF_MEMORY;
+    }
     for (u32 i=0; i<n; i++) {
-        handle_buf[i].index = gl_meshes_size + i;
-        const MeshHandle handle = handle_buf[i];
-        Mesh *const mesh = gl_mesh_get_data(handle);
-        const GLuint *const vao = gl_mesh_get_vao(handle);
-        const GLuint *const vbo = gl_mesh_get_vbo(handle);
-        const GLuint *const ebo = gl_mesh_get_ebo(handle);
-        mesh->verts = verts[i];
-        mesh->indices = indices[i];
-        mesh->indices_cnt = indices_cnt[i];
-        glBindVertexArray(*vao);
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, *ebo);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(GLuint) * indices_cnt[i], indices[i], GL_STATIC_DRAW);
-        glBindBuffer(GL_ARRAY_BUFFER, *vbo);
-        glBufferData(GL_ARRAY_BUFFER, vert_cnts[i] * sizeof(Vertex), verts[i], GL_STATIC_DRAW);
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)(offsetof(Vertex, coord)));
-        glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)(offsetof(Vertex, texcoord)));
-        glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)(offsetof(Vertex, normal)));
-        glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)(offsetof(Vertex, color)));
-        glEnableVertexAttribArray(0);
-        glEnableVertexAttribArray(1);
-        glEnableVertexAttribArray(2);
-        glEnableVertexAttribArray(3);
-    }
-    gl_meshes_size += n;
-    glBindVertexArray(prev_vao);
+        MY_ASSERT(formats[i] < GL_VERTEX_FORMAT_COUNT);
+        const GlVertexLayout *const layout = &gl_vertex_layouts[formats[i]];
+        GlVertexPool *const pool = gl_format_pools[formats[i]];
+        // indices narrow to 16 bits when every vertex is reachable with them
+        const GLenum index_type = vert_cnts[i] <= (u32)UINT16_MAX + 1 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+        const u32 index_units = gl_index_units(indices_cnt[i], index_type);
+        u32 base_vertex;
+        u32 first_unit;
+        if (!gl_range_alloc(&pool->free_verts, vert_cnts[i], &base_vertex)) {
+            if (!gl_pool_grow_verts(pool, vert_cnts[i]) || !gl_range_alloc(&pool->free_verts, vert_cnts[i], &base_vertex)) {
+                gl_mesh_destroy(i, handle_buf);
+                return GL_ERROR_OUT_OF_MEMORY;
+            }
+        }
+        if (!gl_range_alloc(&pool->free_indices, index_units, &first_unit)) {
+            if (!gl_pool_grow_indices(pool, index_units) || !gl_range_alloc(&pool->free_indices, index_units, &first_unit)) {
+                gl_range_free(&pool->free_verts, base_vertex, vert_cnts[i]);
+                gl_mesh_destroy(i, handle_buf);
+                return GL_ERROR_OUT_OF_MEMORY;
+            }
+        }
+
+        u32 index;
+        if (gl_mesh_free_head != GL_MESH_SLOT_NONE) {
+            index = gl_mesh_free_head;
+            gl_mesh_free_head = gl_mesh_slots[index].next_free;
+            gl_mesh_free_cnt--;
+        } else {
+            index = gl_meshes_size++;
+            gl_mesh_slots[index].generation = 1;
+        }
+        gl_mesh_slots[index].next_free = GL_MESH_SLOT_NONE;
+        handle_buf[i] = (MeshHandle) { .index = index, .generation = gl_mesh_slots[index].generation };
+        Mesh *const mesh = &gl_meshes[index];
+        *mesh = (Mesh) {
+            .verts = verts[i],
+            .indices = indices[i],
+            .indices_cnt = indices_cnt[i],
+            .vert_cnt = vert_cnts[i],
+            .format = formats[i],
+            .index_type = index_type,
+            .base_vertex = base_vertex,
+            .first_index = first_unit * (sizeof(GLuint) / gl_index_size(index_type)),
+        };
+
+        if (layout->bounds_relative) {
+            vertex_bounds(verts[i], vert_cnts[i], mesh->center, mesh->extent);
+        }
+        if (layout->encode) {
+            ArenaTemp scratch = arena_scratch_begin(NULL);
+            void *const encoded = arena_alloc(scratch.arena, (size_t)vert_cnts[i] * layout->stride, 16);
+            MY_ASSERT(encoded);
+            layout->encode(encoded, verts[i], vert_cnts[i], mesh->center, mesh->extent);
+            gl_pool_upload_verts(pool, base_vertex, encoded, vert_cnts[i]);
+            arena_scratch_end(scratch);
+        } else {
+            gl_pool_upload_verts(pool, base_vertex, verts[i], vert_cnts[i]);
+        }
+        gl_bind_buffer(GL_COPY_WRITE_BUFFER, pool->ebo);
+        if (index_type == GL_UNSIGNED_SHORT) {
+            ArenaTemp scratch = arena_scratch_begin(NULL);
+            u16 *const narrowed = ARENA_MAKE(scratch.arena, u16, indices_cnt[i]);
+            MY_ASSERT(narrowed);
+            index_narrow_u16(narrowed, indices[i], indices_cnt[i]);
+            glBufferSubData(GL_COPY_WRITE_BUFFER, (size_t)first_unit * sizeof(GLuint), (size_t)indices_cnt[i] * sizeof(u16), narrowed);
+            arena_scratch_end(scratch);
+        } else {
+            glBufferSubData(GL_COPY_WRITE_BUFFER, (size_t)first_unit * sizeof(GLuint), (size_t)indices_cnt[i] * sizeof(GLuint), indices[i]);
+        }
+    }
+    return GL_ERROR_NONE;
 }
 
-GLuint* gl_mesh_get_vao(MeshHandle handle) {
-    MY_ASSERT(gl_vaos);
-    return &gl_vaos[handle.index];
+void gl_mesh_destroy(u32 n, const MeshHandle handles[static n]) {
+    for (u32 i=0; i<n; i++) {
+        const MeshHandle handle = handles[i];
+        MY_ASSERT(gl_mesh_is_alive(handle) && "Destroying a stale MeshHandle");
+        const Mesh *const mesh = &gl_meshes[handle.index];
+        GlVertexPool *const pool = gl_format_pools[mesh->format];
+        // a failed free only leaks the range until gl_deinit
+        gl_range_free(&pool->free_verts, mesh->base_vertex, mesh->vert_cnt);
+        const u32 first_unit = mesh->first_index / (sizeof(GLuint) / gl_index_size(mesh->index_type));
+        gl_range_free(&pool->free_indices, first_unit, gl_index_units(mesh->indices_cnt, mesh->index_type));
+        gl_meshes[handle.index] = (Mesh) { 0 };
+
+        MeshSlot *const slot = &gl_mesh_slots[handle.index];
+        slot->generation++;
+        if (slot->generation == 0) {
+            slot->generation = 1;
+        }
+        slot->next_free = gl_mesh_free_head;
+        gl_mesh_free_head = handle.index;
+        gl_mesh_free_cnt++;
+    }
+}
+
+bool gl_mesh_is_alive(MeshHandle handle) {
+    return handle.index < gl_meshes_size && gl_mesh_slots[handle.index].generation == handle.generation;
 }
 
 Mesh* gl_mesh_get_data(MeshHandle handle) {
-    MY_ASSERT(gl_vaos);
+    MY_ASSERT(gl_mesh_is_alive(handle) && "Stale MeshHandle");
     return &gl_meshes[handle.index];
 }
 
-GLuint* gl_mesh_get_vbo(MeshHandle handle) {
-    MY_ASSERT(gl_vbos_ebos);
-    return &gl_vbos_ebos[handle.index * 2];
+GLuint* gl_mesh_get_vao(MeshHandle handle) {
+    return &gl_format_pools[gl_mesh_get_data(handle)->format]->vao;
+}
+
+GLuint* gl_mesh_get_position_vao(MeshHandle handle) {
+    return &gl_format_pools[gl_mesh_get_data(handle)->format]->position_vao;
+}
+
+GLuint* gl_mesh_get_vbo(MeshHandle handle, GlVertexStream stream) {
+    MY_ASSERT(stream < GL_VERTEX_STREAM_COUNT);
+    return &gl_format_pools[gl_mesh_get_data(handle)->format]->vbos[stream];
 }
 
 GLuint* gl_mesh_get_ebo(MeshHandle handle) {
-    MY_ASSERT(gl_vbos_ebos);
-    return &gl_vbos_ebos[handle.index * 2 + 1];
+    return &gl_format_pools[gl_mesh_get_data(handle)->format]->ebo;
+}
+
+static void gl_mesh_draw_vao(const Mesh *mesh, GLuint vao) {
+    gl_pool_bind_format_block(gl_format_pools[mesh->format]);
+    gl_bind_vao(vao);
+    const void *const indices_offset = (void*)((size_t)mesh->first_index * gl_index_size(mesh->index_type));
+    glDrawElementsBaseVertex(GL_TRIANGLES, mesh->indices_cnt, mesh->index_type, indices_offset, mesh->base_vertex);
 }
 
 void gl_mesh_draw(MeshHandle handle) {
     const Mesh *const mesh = gl_mesh_get_data(handle);
-    glBindVertexArray(gl_vaos[handle.index]);
-    glDrawElements(GL_TRIANGLES, mesh->indices_cnt, GL_UNSIGNED_INT, 0);
+    gl_mesh_draw_vao(mesh, gl_format_pools[mesh->format]->vao);
+}
+
+void gl_mesh_draw_positions(MeshHandle handle) {
+    const Mesh *const mesh = gl_mesh_get_data(handle);
+    gl_mesh_draw_vao(mesh, gl_format_pools[mesh->format]->position_vao);
+}
+
+void gl_batch_begin(GlBatch *batch, Arena *arena) {
+    *batch = (GlBatch) { .arena = arena };
+}
+
+bool gl_batch_reserve(GlBatch *batch, u32 cap) {
+    if (cap <= batch->cap) {
+        return true;
+    }
+    GlBatchItem *const items = arena_realloc(batch->arena, batch->items, sizeof(GlBatchItem) * batch->cap, sizeof(GlBatchItem) * cap, alignof(GlBatchItem));
+    if (!items) return false;
+    batch->items = items;
+    batch->cap = cap;
+    return true;
+}
+
+void gl_batch_clear(GlBatch *batch) {
+    batch->size = 0;
+}
+
+bool gl_batch_add(GlBatch *batch, MeshHandle handle, const f32 *transform, const f32 *tint) {
+    const Mesh *const mesh = gl_mesh_get_data(handle);
+    MY_ASSERT((!batch->size || gl_vertex_formats_share_pool(mesh->format, batch->format)) && "A batch holds a single vertex layout");
+    if (batch->size == batch->cap && !gl_batch_reserve(batch, batch->cap ? batch->cap * 2 : 64)) {
+        return false;
+    }
+    batch->format = mesh->format;
+    batch->items[batch->size++] = (GlBatchItem) { .transform = transform, .tint = tint, .mesh_index = handle.index };
+    return true;
+}
+
+static void gl_instance_init(GlInstance *instance, const Mesh *mesh, const f32 *transform, const f32 *tint) {
+    if (gl_vertex_layouts[mesh->format].bounds_relative) {
+        // scale and offset the snorm coords before the model transform; the
+        // shader multiplies row vectors, so each column's dot with the coord
+        // picks up the extent per row and the center in the w row
+        for (u32 col=0; col<4; col++) {
+            const f32 *const src = &transform[col * 4];
+            f32 *const dst = &instance->transform[col * 4];
+            dst[0] = src[0] * mesh->extent[0];
+            dst[1] = src[1] * mesh->extent[1];
+            dst[2] = src[2] * mesh->extent[2];
+            dst[3] = src[0] * mesh->center[0] + src[1] * mesh->center[1] + src[2] * mesh->center[2] + src[3];
+        }
+    } else {
+        memcpy(instance->transform, transform, sizeof(instance->transform));
+    }
+    memcpy(instance->tint, tint, sizeof(instance->tint));
+}
+
+// LSD radix sort of item indices by mesh slot, stable so instances keep their
+// submission order; passes where every slot has the same byte are skipped.
+// Returns whichever of src and dst holds the result.
+static u32* gl_batch_sort(const GlBatchItem *items, u32 *src, u32 *dst, u32 n) {
+    u32 counts[sizeof(u32)][256] = { 0 };
+    for (u32 i=0; i<n; i++) {
+        src[i] = i;
+        for (u32 byte=0; byte<sizeof(u32); byte++) {
+            counts[byte][(items[i].mesh_index >> (byte * 8)) & 0xff]++;
+        }
+    }
+    for (u32 byte=0; byte<sizeof(u32); byte++) {
+        u32 *const count = counts[byte];
+        const u32 shift = byte * 8;
+        if (count[(items[0].mesh_index >> shift) & 0xff] == n) {
+            continue;
+        }
+        u32 offset = 0;
+        for (u32 digit=0; digit<256; digit++) {
+            const u32 digit_cnt = count[digit];
+            count[digit] = offset;
+            offset += digit_cnt;
+        }
+        for (u32 i=0; i<n; i++) {
+            dst[count[(items[src[i]].mesh_index >> shift) & 0xff]++] = src[i];
+        }
+        u32 *const tmp = src;
+        src = dst;
+        dst = tmp;
+    }
+    return src;
+}
+
+u32 gl_batch_submit(GlBatch *batch) {
+    if (!batch->size) {
+        return 0;
+    }
+    ArenaTemp temp = arena_temp_begin(batch->arena);
+    u32 *const order_a = ARENA_MAKE(temp.arena, u32, batch->size);
+    u32 *const order_b = ARENA_MAKE(temp.arena, u32, batch->size);
+    GlInstance *const sorted = ARENA_MAKE(temp.arena, GlInstance, batch->size);
+    GlDrawCommand *const cmds = ARENA_MAKE(temp.arena, GlDrawCommand, batch->size);
+    if (!order_a || !order_b || !sorted || !cmds) {
+        arena_temp_end(temp);
+        return 0;
+    }
+    // only the batch's own items are sorted, each mesh's instances end up contiguous
+    const u32 *const order = gl_batch_sort(batch->items, order_a, order_b, batch->size);
+    for (u32 i=0; i<batch->size; i++) {
+        const GlBatchItem *const item = &batch->items[order[i]];
+        gl_instance_init(&sorted[i], &gl_meshes[item->mesh_index], item->transform, item->tint);
+    }
+    // one multi draw per index type, the 16-bit commands go first
+    u32 short_cmd_cnt = 0;
+    for (u32 i=0; i<batch->size; i++) {
+        const u32 mesh_index = batch->items[order[i]].mesh_index;
+        const bool run_start = i == 0 || batch->items[order[i - 1]].mesh_index != mesh_index;
+        if (run_start && gl_meshes[mesh_index].index_type == GL_UNSIGNED_SHORT) {
+            short_cmd_cnt++;
+        }
+    }
+    u32 cmd_cnt = 0;
+    u32 short_cmd_next = 0;
+    u32 int_cmd_next = short_cmd_cnt;
+    for (u32 run=0; run<batch->size;) {
+        const u32 mesh_index = batch->items[order[run]].mesh_index;
+        u32 run_end = run + 1;
+        while (run_end < batch->size && batch->items[order[run_end]].mesh_index == mesh_index) {
+            run_end++;
+        }
+        const Mesh *const mesh = &gl_meshes[mesh_index];
+        const u32 cmd_index = mesh->index_type == GL_UNSIGNED_SHORT ? short_cmd_next++ : int_cmd_next++;
+        cmd_cnt++;
+        cmds[cmd_index] = (GlDrawCommand) {
+            .count = mesh->indices_cnt,
+            .instance_count = run_end - run,
+            .first_index = mesh->first_index,
+            .base_vertex = mesh->base_vertex,
+            .base_instance = run,
+        };
+        run = run_end;
+    }
+
+    // instance ids index the whole stream, shift the commands to where the instances landed
+    const size_t instances_offset = gl_stream_push(&gl_stream, sorted, sizeof(GlInstance) * batch->size, sizeof(GlInstance));
+    if (instances_offset == GL_STREAM_FULL) {
+        arena_temp_end(temp);
+        return 0;
+    }
+    const u32 first_id = instances_offset / sizeof(GlInstance);
+    for (u32 i=0; i<cmd_cnt; i++) {
+        cmds[i].base_instance += first_id;
+    }
+    gl_bind_texture(GL_INSTANCES_TEXTURE_UNIT, GL_TEXTURE_BUFFER, gl_instance_texture);
+    gl_instance_ids_reserve(first_id + batch->size);
+    const GlVertexPool *const pool = gl_format_pools[batch->format];
+    gl_pool_bind_format_block(pool);
+    gl_bind_vao(batch->position_only ? pool->position_vao : pool->vao);
+    if (gl_multi_draw_indirect) {
+        const size_t cmds_offset = gl_stream_push(&gl_stream, cmds, sizeof(GlDrawCommand) * cmd_cnt, alignof(GlDrawCommand));
+        if (cmds_offset == GL_STREAM_FULL) {
+            arena_temp_end(temp);
+            return 0;
+        }
+        gl_bind_buffer(GL_DRAW_INDIRECT_BUFFER, gl_stream.buffer);
+        if (short_cmd_cnt) {
+            glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_SHORT, (void*)cmds_offset, short_cmd_cnt, 0);
+        }
+        if (cmd_cnt > short_cmd_cnt) {
+            const size_t int_cmds_offset = cmds_offset + sizeof(GlDrawCommand) * short_cmd_cnt;
+            glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, (void*)int_cmds_offset, cmd_cnt - short_cmd_cnt, 0);
+        }
+    } else {
+        // no base_instance before GL 4.2, the instance ids start at the attribute offset instead
+        gl_bind_buffer(GL_ARRAY_BUFFER, gl_instance_id_buffer);
+        for (u32 i=0; i<cmd_cnt; i++) {
+            const GlDrawCommand *const cmd = &cmds[i];
+            const GLenum index_type = i < short_cmd_cnt ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+            const void *const indices_offset = (void*)((size_t)cmd->first_index * gl_index_size(index_type));
+            glVertexAttribIPointer(GL_INSTANCE_ID_ATTRIB, 1, GL_UNSIGNED_INT, sizeof(u32), (void*)((size_t)cmd->base_instance * sizeof(u32)));
+            glDrawElementsInstancedBaseVertex(GL_TRIANGLES, cmd->count, index_type, indices_offset, cmd->instance_count, cmd->base_vertex);
+        }
+        // the pointer is VAO state, plain draws of this pool expect ids from 0
+        glVertexAttribIPointer(GL_INSTANCE_ID_ATTRIB, 1, GL_UNSIGNED_INT, sizeof(u32), 0);
+    }
+    arena_temp_end(temp);
+    return cmd_cnt;
+}
+
+bool gl_set_multi_draw_indirect(bool enabled) {
+    gl_multi_draw_indirect = enabled && gl_multi_draw_indirect_supported;
+    return gl_multi_draw_indirect == enabled;
+}
+
+void gl_frame_begin(void) {
+    gl_stream_begin_frame(&gl_stream);
+}
+
+void gl_frame_end(void) {
+    gl_stream_end_frame(&gl_stream);
+}
+
+const GlStream* gl_get_stream(void) {
+    return &gl_stream;
+}
+
+void gl_program_bind_blocks(GLuint prog) {
+    const GLuint camera_index = glGetUniformBlockIndex(prog, "Camera");
+    if (camera_index != GL_INVALID_INDEX) {
+        glUniformBlockBinding(prog, camera_index, GL_CAMERA_BLOCK_BINDING);
+    }
+    const GLuint format_index = glGetUniformBlockIndex(prog, "VertexFormat");
+    if (format_index != GL_INVALID_INDEX) {
+        glUniformBlockBinding(prog, format_index, GL_VERTEX_FORMAT_BLOCK_BINDING);
+    }
+}
+
+bool gl_camera_upload(const GlCameraBlock *camera) {
+    const size_t offset = gl_stream_push(&gl_stream, camera, sizeof(*camera), gl_uniform_alignment);
+    if (offset == GL_STREAM_FULL) {
+        return false;
+    }
+    gl_bind_buffer_range(GL_UNIFORM_BUFFER, GL_CAMERA_BLOCK_BINDING, gl_stream.buffer, offset, sizeof(*camera));
+    return true;
 }
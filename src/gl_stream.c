@@ -0,0 +1,114 @@
+#include "gl_stream.h"
+#include "gl.h"
+
+#include <string.h>
+
+bool gl_stream_init(GlStream *stream, size_t size, u32 region_cnt) {
+    MY_ASSERT(region_cnt && region_cnt <= GL_STREAM_MAX_REGIONS);
+    *stream = (GlStream) {
+        .region_size = size / region_cnt,
+        .region_cnt = region_cnt,
+        .region = region_cnt - 1,
+    };
+    stream->size = stream->region_size * region_cnt;
+    glGenBuffers(1, &stream->buffer);
+    gl_bind_buffer(GL_COPY_WRITE_BUFFER, stream->buffer);
+    if (GLEW_VERSION_4_4 || GLEW_ARB_buffer_storage) {
+        const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        glBufferStorage(GL_COPY_WRITE_BUFFER, stream->size, NULL, flags);
+        stream->mapped = glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, stream->size, flags);
+        if (stream->mapped) {
+            stream->mode = GL_STREAM_MODE_PERSISTENT;
+            return true;
+        }
+        // immutable storage cannot be respecified, start over with a new name
+        gl_delete_buffers(1, &stream->buffer);
+        glGenBuffers(1, &stream->buffer);
+        gl_bind_buffer(GL_COPY_WRITE_BUFFER, stream->buffer);
+    }
+    stream->mode = GL_STREAM_MODE_UNSYNCHRONIZED;
+    glBufferData(GL_COPY_WRITE_BUFFER, stream->size, NULL, GL_STREAM_DRAW);
+    return stream->buffer != 0;
+}
+
+void gl_stream_destroy(GlStream *stream) {
+    for (u32 i=0; i<stream->region_cnt; i++) {
+        if (stream->fences[i]) {
+            glDeleteSync(stream->fences[i]);
+        }
+    }
+    if (stream->mapped) {
+        gl_bind_buffer(GL_COPY_WRITE_BUFFER, stream->buffer);
+        glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+    }
+    gl_delete_buffers(1, &stream->buffer);
+    *stream = (GlStream) { 0 };
+}
+
+// new storage under the same name, the driver keeps the old one alive for the GPU
+static void gl_stream_orphan(GlStream *stream) {
+    gl_bind_buffer(GL_COPY_WRITE_BUFFER, stream->buffer);
+    glBufferData(GL_COPY_WRITE_BUFFER, stream->size, NULL, GL_STREAM_DRAW);
+    for (u32 i=0; i<stream->region_cnt; i++) {
+        if (stream->fences[i]) {
+            glDeleteSync(stream->fences[i]);
+            stream->fences[i] = NULL;
+        }
+    }
+    stream->orphan_cnt++;
+}
+
+void gl_stream_begin_frame(GlStream *stream) {
+    stream->region = (stream->region + 1) % stream->region_cnt;
+    stream->head = 0;
+    GLsync const fence = stream->fences[stream->region];
+    if (!fence) {
+        return;
+    }
+    GLenum status = glClientWaitSync(fence, 0, 0);
+    if (status == GL_TIMEOUT_EXPIRED) {
+        if (stream->mode == GL_STREAM_MODE_UNSYNCHRONIZED) {
+            gl_stream_orphan(stream);
+            return;
+        }
+        stream->stall_cnt++;
+        do {
+            status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000 * 1000);
+        } while (status == GL_TIMEOUT_EXPIRED);
+    }
+    MY_ASSERT(status != GL_WAIT_FAILED);
+    glDeleteSync(fence);
+    stream->fences[stream->region] = NULL;
+}
+
+void gl_stream_end_frame(GlStream *stream) {
+    MY_ASSERT(!stream->fences[stream->region]);
+    stream->fences[stream->region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+size_t gl_stream_push(GlStream *stream, const void *data, size_t size, size_t alignment) {
+    MY_ASSERT(alignment);
+    const size_t region_start = stream->region * stream->region_size;
+    const size_t region_end = region_start + stream->region_size;
+    // offsets are aligned in the whole buffer, callers turn them into element indices
+    const size_t offset = (region_start + stream->head + alignment - 1) / alignment * alignment;
+    if (offset > region_end || region_end - offset < size) {
+        return GL_STREAM_FULL;
+    }
+    if (size) {
+        if (stream->mode == GL_STREAM_MODE_PERSISTENT) {
+            memcpy(stream->mapped + offset, data, size);
+        } else {
+            gl_bind_buffer(GL_COPY_WRITE_BUFFER, stream->buffer);
+            void *const dst = glMapBufferRange(GL_COPY_WRITE_BUFFER, offset, size, GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT | GL_MAP_INVALIDATE_RANGE_BIT);
+            if (!dst) {
+                return GL_STREAM_FULL;
+            }
+            memcpy(dst, data, size);
+            glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+        }
+    }
+    stream->head = offset + size - region_start;
+    stream->bytes_streamed += size;
+    return offset;
+}
@@ -5,7 +5,13 @@
 
 #include "common.h"
 #include "arena.h"
+#include "double_stack.h"
+#include "alloc_stats.h"
+#include "frame_arenas.h"
+#include "dyn_array.h"
 #include "gl.h"
+#include "mesh_opt.h"
+#include "render_queue.h"
 #include "shader_manager.h"
 
 #define RAYMATH_STATIC_INLINE
@@ -33,8 +39,12 @@ typedef struct Transform {
 typedef struct GameObject {
     MeshHandle mesh;
     Transform transform;
+    // multiplies the vertex colors
+    Vector4 tint;
 } GameObject;
 
+DYN_ARRAY_DEFINE(GameObjectArray, game_object_array, GameObject)
+
 typedef struct Camera {
     Vector3 up;
     Vector3 eye;
@@ -42,24 +52,23 @@ typedef struct Camera {
 } Camera;
 
 static Camera cam;
-static Matrix proj_view;
-static void game_object_draw(const GameObject *obj);
+static Matrix game_object_model(const GameObject *obj);
 
 static void camera_yaw(Camera *cam, float angle);
 static void camera_pitch(Camera *cam, float angle);
 
 static Vertex cube_verts[] = {
     // Дальние (z+)
-    { { 0.5, -0.5,  0.5}, {1, 0}, {0, 0, 1}, {1, 0, 0} },
-    { {-0.5, -0.5,  0.5}, {1, 0}, {0, 0, -1}, {1, 0, 0} },
-    { {-0.5,  0.5,  0.5}, {1, 1}, {0, 0, -1}, {1, 0, 0} },
-    { { 0.5,  0.5,  0.5}, {1, 1}, {0, 0, 1}, {1, 0, 0} },
+    { { 0.5, -0.5,  0.5}, {1, 0}, { 0.57735, -0.57735,  0.57735}, {1, 0, 0} },
+    { {-0.5, -0.5,  0.5}, {1, 0}, {-0.57735, -0.57735,  0.57735}, {1, 0, 0} },
+    { {-0.5,  0.5,  0.5}, {1, 1}, {-0.57735,  0.57735,  0.57735}, {1, 0, 0} },
+    { { 0.5,  0.5,  0.5}, {1, 1}, { 0.57735,  0.57735,  0.57735}, {1, 0, 0} },
 
     // Ближние (z-)
-    { { 0.5, -0.5, -0.5}, {0, 0}, {0, 0, 1}, {0, 1, 0} },
-    { {-0.5, -0.5, -0.5}, {0, 0}, {0, 0, -1}, {0, 1, 0} },
-    { {-0.5,  0.5, -0.5}, {0, 1}, {0, 0, -1}, {0, 1, 0} },
-    { { 0.5,  0.5, -0.5}, {0, 1}, {0, 0, 1}, {0, 1, 0} },
+    { { 0.5, -0.5, -0.5}, {0, 0}, { 0.57735, -0.57735, -0.57735}, {0, 1, 0} },
+    { {-0.5, -0.5, -0.5}, {0, 0}, {-0.57735, -0.57735, -0.57735}, {0, 1, 0} },
+    { {-0.5,  0.5, -0.5}, {0, 1}, {-0.57735,  0.57735, -0.57735}, {0, 1, 0} },
+    { { 0.5,  0.5, -0.5}, {0, 1}, { 0.57735,  0.57735, -0.57735}, {0, 1, 0} },
 };
 static_assert(ARRAY_LEN(cube_verts) == 8);
 static GLuint cube_indices[] = {
@@ -97,17 +106,17 @@ static GLuint floor_indices[] = {
     1, 2, 3
 };
 
-static Mesh meshes[4096];
-static GLuint vaos[ARRAY_LEN(meshes)];
-static GLuint vbos_ebos [ARRAY_LEN(meshes) * 2];
 GLuint prog;
 
-enum { PERSIST_ARENA_SIZE = 1024 * 1024 * 1024 };
-u8 persist_arena_buf[ PERSIST_ARENA_SIZE ];
-u8 tmp_arena_buf[1024 * 1024 * 5];
+// address space only, pages get committed as either end grows
+static const size_t MEMORY_RESERVE = (size_t)16 * 1024 * 1024 * 1024;
 
-Arena g_arena;
-Arena tmp_arena;
+// persistent end for process lifetime data, transient end for the level
+DoubleStack g_memory;
+static Arena *const g_arena = &g_memory.persistent;
+AllocStats persist_stats;
+static AllocStatsCallSite persist_call_sites[64];
+AllocStats transient_stats;
 StringView shader_log;
 
 const StringView vertex_shader_path = SV_FROM_LIT_Z("shaders/vert.glsl");
@@ -116,12 +125,16 @@ const StringView fragment_shader_path = SV_FROM_LIT_Z("shaders/frag.glsl");
 int main(int argc, char **argv) {
     UNUSED(argc);
     UNUSED(argv);
-    arena_init(&g_arena, persist_arena_buf, sizeof(persist_arena_buf));
-    arena_init(&tmp_arena, tmp_arena_buf, sizeof(tmp_arena_buf));
     int retval = 0;
+    if (!double_stack_init_virtual(&g_memory, MEMORY_RESERVE, ARENA_FLAG_NONE)) {
+        SDL_Log("%s\n", "Failed to reserve memory");
+        retval = -1;
+        goto return_lbl;
+    }
+    SDL_Log("Persistent arena page size: %zu\n", g_arena->page_size);
     EXCEPT_SUCC_SDL(SDL_Init(SDL_INIT_VIDEO), return_lbl);
     SDL_GL_SetAttribute( SDL_GL_CONTEXT_MAJOR_VERSION, 3 );
-    SDL_GL_SetAttribute( SDL_GL_CONTEXT_MINOR_VERSION, 1 );
+    SDL_GL_SetAttribute( SDL_GL_CONTEXT_MINOR_VERSION, 3 );
     SDL_GL_SetAttribute( SDL_GL_CONTEXT_PROFILE_MASK, SDL_GL_CONTEXT_PROFILE_CORE );
     SDL_Window *const win = SDL_CreateWindow("Hello", 800, 600, SDL_WINDOW_OPENGL | SDL_WINDOW_RESIZABLE);
     EXCEPT_SUCC_SDL(win, quit_sdl_lbl);
@@ -138,8 +151,8 @@ int main(int argc, char **argv) {
     ShaderMgr shader_mgr;
     ShaderMgrError shader_mgr_err;
 
-    Arena restore = g_arena;
-    shader_mgr_err = shader_mgr_init(&shader_mgr, vertex_shader_path, fragment_shader_path, &g_arena, &shader_log);
+    ArenaTemp init_temp = arena_temp_begin(g_arena);
+    shader_mgr_err = shader_mgr_init(&shader_mgr, vertex_shader_path, fragment_shader_path, g_arena, &shader_log);
     switch (shader_mgr_err) {
         case SHADER_MGR_ERROR_COMPILE_VERT_SHADER:
             SDL_Log("Vert: " SV_FSPEC "\n", SV_FARGS(shader_log));
@@ -152,13 +165,15 @@ int main(int argc, char **argv) {
             return -1;
         default:
     }
-    g_arena = restore;
+    arena_temp_end(init_temp);
 
-    shader_mgr_err = shader_mgr_get_program(&shader_mgr, &prog, &g_arena, &shader_log);
+    shader_mgr_err = shader_mgr_get_program(&shader_mgr, &prog, g_arena, &shader_log);
     if (shader_mgr_err != 0) {
         SDL_Log(SV_FSPEC "\n", SV_FARGS(shader_log));
         return -1;
     }
+    gl_program_bind_blocks(prog);
+    const ShaderName instances_uniform = shader_mgr_intern(&shader_mgr, (StringView)SV_FROM_LIT("instances"));
 
     int num_keys;
     kb_state = SDL_GetKeyboardState(&num_keys);
@@ -167,41 +182,85 @@ int main(int argc, char **argv) {
         retval = -1;
         goto destroy_gl_ctx_lbl;
     }
-    gl_init(ARRAY_LEN(meshes), meshes, vaos, vbos_ebos);
+    alloc_stats_init(&persist_stats, "persist", (AllocatorPoly)ARENA_POLY(g_arena), ALLOC_STATS_FLAG_NO_FREE);
+    alloc_stats_enable_call_sites(&persist_stats, persist_call_sites, ARRAY_LEN(persist_call_sites));
+    const AllocatorPoly persist_alloc = ALLOC_STATS_POLY(&persist_stats);
+    ALLOC_STATS_HERE();
+    if (gl_init(persist_alloc, 64) != GL_ERROR_NONE) {
+        SDL_Log("%s\n", "Failed to allocate mesh storage");
+        retval = -1;
+        goto destroy_gl_ctx_lbl;
+    }
     MeshHandle handles[2];
     u32 vert_cnts[] = { ARRAY_LEN(cube_verts), ARRAY_LEN(floor_verts) };
     u32 indices_cnts[] = { ARRAY_LEN(cube_indices), ARRAY_LEN(floor_indices) };
     Vertex *verts_arr[] = { cube_verts, floor_verts };
     GLuint *indices_arr[] = { cube_indices, floor_indices };
-    gl_mesh_init(2, handles, verts_arr, indices_arr, vert_cnts, indices_cnts);
-    GameObject cube = {
+    const GlVertexFormat formats[] = { GL_VERTEX_FORMAT_PACKED, GL_VERTEX_FORMAT_COLORED };
+    for (u32 i=0; i<ARRAY_LEN(handles); i++) {
+        MeshOptStats opt_stats;
+        if (mesh_optimize(verts_arr[i], vert_cnts[i], indices_arr[i], indices_cnts[i], &opt_stats)) {
+            SDL_Log("[mesh %u] ACMR %.3f -> %.3f, ATVR %.3f -> %.3f\n", i,
+                opt_stats.before.acmr, opt_stats.after.acmr, opt_stats.before.atvr, opt_stats.after.atvr);
+        }
+    }
+    if (gl_mesh_init(2, handles, verts_arr, indices_arr, vert_cnts, indices_cnts, formats) != GL_ERROR_NONE) {
+        SDL_Log("%s\n", "Failed to allocate meshes");
+        retval = -1;
+        goto destroy_gl_ctx_lbl;
+    }
+    const GameObject cube = {
         .mesh = handles[0],
         .transform = {
             .position = { 1, 1, 1 },
             .scale = {0.2, 0.2, 0.2},
             .rotation = { 0 }
-        }
+        },
+        .tint = { 1, 1, 1, 1 },
     };
-    GameObject floor = {
+    const GameObject floor = {
         .mesh = handles[1],
         .transform = {
             .position = { 0 },
             .scale = {1, 1, 1},
             .rotation = { 0 },
-        }
+        },
+        .tint = { 1, 1, 1, 1 },
     };
+    // unloading the level is a rollback to this marker
+    const DoubleStackMarker level_marker = double_stack_marker(&g_memory, DOUBLE_STACK_TRANSIENT);
+    // the transient end only reclaims a free of its topmost block
+    alloc_stats_init(&transient_stats, "transient", (AllocatorPoly)DOUBLE_STACK_TRANSIENT_POLY(&g_memory), ALLOC_STATS_FLAG_NO_FREE);
+    GameObjectArray scene;
+    game_object_array_init(&scene, (AllocatorPoly)ALLOC_STATS_POLY(&transient_stats));
+    if (!game_object_array_append(&scene, cube) || !game_object_array_append(&scene, floor)) {
+        SDL_Log("%s\n", "Failed to allocate scene");
+        retval = -1;
+        goto destroy_gl_ctx_lbl;
+    }
     SDL_Event ev;
     bool quit = false;
     u64 last = SDL_GetTicks();
     u8 watch_frame_counter = 0;
     SDL_SetWindowRelativeMouseMode(win, true);
     cam.target = (Vector3) { 0, 0, 0 };
-    enum { FRAME_ARENA_SIZE = 1024 * 1024 * 6 };
-    u8* frame_arena_buf = ARENA_MAKE(&g_arena, u8, FRAME_ARENA_SIZE);
-    Arena frame_arena;
-    arena_init(&frame_arena, frame_arena_buf, FRAME_ARENA_SIZE);
+    // the model matrices, the render queue and its batches dominate a frame,
+    // the rest fits in the slack
+    enum { FRAME_MAX_OBJECTS = 64 * 1024 };
+    enum { FRAME_ARENA_SIZE = FRAME_MAX_OBJECTS * (sizeof(Matrix) + RENDER_QUEUE_ITEM_BYTES) + 256 * 1024 };
+    FrameArenas frame_arenas;
+    ALLOC_STATS_HERE();
+    if (!frame_arenas_init(&frame_arenas, persist_alloc, FRAME_ARENA_SIZE, GL_FRAMES_IN_FLIGHT)) {
+        SDL_Log("%s\n", "Failed to allocate frame arenas");
+        retval = -1;
+        goto destroy_gl_ctx_lbl;
+    }
+    // everything persistent is set up, frames must not grow the persistent arena
+    persist_stats.assert_no_frame_growth = true;
     while (!quit) {
-        arena_clear(&frame_arena);
+        Arena *const frame_arena = frame_arenas_begin(&frame_arenas);
+        gl_frame_begin();
+        alloc_stats_begin_frame(&persist_stats);
         f32 dx = 0;
         f32 dy = 0;
         u64 cur_time = SDL_GetTicks();
@@ -209,15 +268,14 @@ int main(int argc, char **argv) {
         watch_frame_counter++;
         if (watch_frame_counter > 60) {
             bool reloaded;
-            shader_mgr_err = shader_mgr_reload_if_needed(&shader_mgr, &reloaded, &frame_arena, &shader_log);
+            shader_mgr_err = shader_mgr_reload_if_needed(&shader_mgr, &reloaded, frame_arena, &shader_log);
             if (shader_mgr_err != SHADER_MGR_ERROR_NONE) {
                 SDL_Log("Shader reload err: " SV_FSPEC "\n", SV_FARGS(shader_log));
             }
             if (reloaded) {
-                shader_mgr_err = shader_mgr_get_program(&shader_mgr, &prog, &frame_arena, &shader_log);
-                if (shader_mgr_err != 0) {
-                    SDL_Log("Shader reload error: " SV_FSPEC  "\n", SV_FARGS(shader_log));
-                }
+                // the reload already linked and reflected the new program
+                prog = shader_mgr.prog;
+                gl_program_bind_blocks(prog);
                 SDL_Log("%s\n", "Reload");
             }
         }
@@ -227,7 +285,7 @@ int main(int argc, char **argv) {
                     quit = true;
                     break;
                 case SDL_EVENT_WINDOW_RESIZED:
-                    glViewport(0, 0, ev.window.data1, ev.window.data2);
+                    gl_set_viewport(0, 0, ev.window.data1, ev.window.data2);
                     break;
                 case SDL_EVENT_MOUSE_MOTION:
                     if (SDL_GetWindowRelativeMouseMode(win)){
@@ -274,6 +332,18 @@ int main(int argc, char **argv) {
         if (is_key_just_pressed(SDL_SCANCODE_R)) {
             memset(&cam.eye, 0, sizeof(cam.eye));
         }
+        if (is_key_just_pressed(SDL_SCANCODE_F1)) {
+            alloc_stats_sample_arena(&persist_stats, g_arena);
+            alloc_stats_report(&persist_stats);
+            alloc_stats_report(&transient_stats);
+            SDL_Log("[frame] high_water=%zu of %zu\n", frame_arenas_high_water(&frame_arenas), (size_t)FRAME_ARENA_SIZE);
+            SDL_Log("[scratch] high_water=%zu\n", arena_scratch_high_water());
+            const GlStream *const stream = gl_get_stream();
+            SDL_Log("[shaders] uploads=%llu skipped=%llu\n", (unsigned long long)shader_mgr.upload_cnt, (unsigned long long)shader_mgr.upload_skip_cnt);
+            const GlStateStats *const state_stats = gl_get_state_stats();
+            SDL_Log("[gl state] issued=%llu elided=%llu\n", (unsigned long long)state_stats->issued, (unsigned long long)state_stats->elided);
+            SDL_Log("[stream] stalls=%llu orphans=%llu bytes=%llu\n", (unsigned long long)stream->stall_cnt, (unsigned long long)stream->orphan_cnt, (unsigned long long)stream->bytes_streamed);
+        }
         if (is_key_just_pressed(SDL_SCANCODE_T)) {
             cam.target = cube.transform.position;
         }
@@ -303,16 +373,51 @@ int main(int argc, char **argv) {
 
         const Matrix proj = MatrixPerspective(DEG2RAD * 45, 800.f/600.f, 0.1, 100);
         const Matrix view = MatrixLookAt(cam.eye, cam.target, cam.up);
-        proj_view = MatrixMultiply(view, proj);
-        glUniformMatrix4fv(glGetUniformLocation(prog, "proj_view"), 1, GL_FALSE, &proj_view.m0);
-        glUseProgram(prog);
+        GlCameraBlock camera_block = { .eye = { cam.eye.x, cam.eye.y, cam.eye.z, 1 } };
+        const Matrix proj_view = MatrixMultiply(view, proj);
+        memcpy(camera_block.proj_view, &proj_view.m0, sizeof(camera_block.proj_view));
+        if (!gl_camera_upload(&camera_block)) {
+            SDL_Log("%s\n", "Stream region is full, camera not updated");
+        }
+        gl_use_program(prog);
+        shader_mgr_set_int(&shader_mgr, instances_uniform, GL_INSTANCES_TEXTURE_UNIT);
         glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-        game_object_draw(&cube);
-        game_object_draw(&floor);
+        // the queue reads the transforms on submit, they live in the frame arena until then
+        Matrix *const models = ARENA_MAKE(frame_arena, Matrix, scene.size);
+        RenderQueue queue;
+        render_queue_begin(&queue, frame_arena);
+        render_queue_reserve(&queue, scene.size);
+        for (u32 i=0; models && i<scene.size; i++) {
+            const GameObject *const obj = &scene.data[i];
+            Matrix *const model = &models[i];
+            *model = game_object_model(obj);
+            const RenderItem item = {
+                .mesh = obj->mesh,
+                .program = prog,
+                .depth = Vector3Distance(cam.eye, obj->transform.position),
+                .translucent = obj->tint.w < 1,
+                .transform = &model->m0,
+                .tint = &obj->tint.x,
+            };
+            // a full arena shows up in the stats' dropped count
+            render_queue_push(&queue, &item);
+        }
+        const RenderQueueStats queue_stats = render_queue_submit(&queue, NULL, NULL);
+        const u32 dropped = models ? queue_stats.dropped : scene.size;
+        if (dropped) {
+            SDL_Log("Dropped %u of %u draws, the frame arena or stream region is full\n", dropped, scene.size);
+        }
+        gl_frame_end();
+        frame_arenas_end(&frame_arenas);
         SDL_GL_SwapWindow(win);
+        alloc_stats_end_frame(&persist_stats);
     }
+    frame_arenas_destroy(&frame_arenas);
+    gl_mesh_destroy(ARRAY_LEN(handles), handles);
+    gl_deinit();
+    double_stack_rollback(&g_memory, level_marker);
 
 destroy_gl_ctx_lbl:
     SDL_GL_DestroyContext(gl_ctx);
@@ -320,6 +425,7 @@ destroy_win_lbl:
     SDL_DestroyWindow(win);
 quit_sdl_lbl:
     SDL_Quit();
+    double_stack_release(&g_memory);
 return_lbl:
     return retval;
 }
@@ -345,12 +451,9 @@ static void camera_pitch(Camera *cam, float angle) {
     cam->target = Vector3Add(cam->eye, new_forward);
 }
 
-static void game_object_draw(const GameObject *obj) {
-    UNUSED(cam);
+static Matrix game_object_model(const GameObject *obj) {
     const Transform *const tr = &obj->transform;
     const Matrix translation = MatrixTranslate(tr->position.x, tr->position.y, tr->position.z);
     const Matrix scale = MatrixScale(tr->scale.x, tr->scale.y, tr->scale.z);
-    const Matrix model = MatrixMultiply(translation, scale);
-    glUniformMatrix4fv(glGetUniformLocation(prog, "model"), 1, GL_FALSE, &model.m0);
-    gl_mesh_draw(obj->mesh);
+    return MatrixMultiply(translation, scale);
 }
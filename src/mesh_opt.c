@@ -0,0 +1,308 @@
+#include "mesh_opt.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "arena.h"
+
+enum { MESH_OPT_NONE = UINT32_MAX };
+
+// a run of triangles is cut into its own overdraw cluster once its ACMR is
+// within this factor of the ACMR of the whole dead-end free run
+#define MESH_OPT_OVERDRAW_THRESHOLD 1.05f
+
+typedef struct MeshCluster {
+    u32 first_tri;
+    u32 tri_cnt;
+    f32 sort_key;
+} MeshCluster;
+
+// FIFO cache with insertion timestamps, bumping time by cache_size + 1 empties it
+static u32 mesh_cache_triangle(u32 *timestamps, u32 *time, u32 cache_size, const u32 tri[static 3]) {
+    u32 misses = 0;
+    for (u32 k=0; k<3; k++) {
+        if (*time - timestamps[tri[k]] > cache_size) {
+            timestamps[tri[k]] = (*time)++;
+            misses++;
+        }
+    }
+    return misses;
+}
+
+MeshCacheStats mesh_cache_stats(const u32 *indices, u32 index_cnt, u32 vert_cnt, u32 cache_size) {
+    MeshCacheStats stats = { 0 };
+    if (index_cnt < 3 || !vert_cnt) {
+        return stats;
+    }
+    ArenaTemp scratch = arena_scratch_begin(NULL);
+    u32 *const timestamps = ARENA_MAKE(scratch.arena, u32, vert_cnt);
+    MY_ASSERT(timestamps);
+    memset(timestamps, 0, sizeof(u32) * vert_cnt);
+    u32 time = cache_size + 1;
+    u32 misses = 0;
+    for (u32 i=0; i+3<=index_cnt; i+=3) {
+        MY_ASSERT(indices[i] < vert_cnt && indices[i + 1] < vert_cnt && indices[i + 2] < vert_cnt);
+        misses += mesh_cache_triangle(timestamps, &time, cache_size, &indices[i]);
+    }
+    arena_scratch_end(scratch);
+    stats.acmr = (f32)misses / (f32)(index_cnt / 3);
+    stats.atvr = (f32)misses / (f32)vert_cnt;
+    return stats;
+}
+
+static u32 mesh_tipsify_skip_dead_end(const u32 *live, const u32 *dead_end, u32 *dead_end_size, u32 *cursor, u32 vert_cnt) {
+    while (*dead_end_size) {
+        const u32 vert = dead_end[--*dead_end_size];
+        if (live[vert]) {
+            return vert;
+        }
+    }
+    while (*cursor < vert_cnt) {
+        const u32 vert = (*cursor)++;
+        if (live[vert]) {
+            return vert;
+        }
+    }
+    return MESH_OPT_NONE;
+}
+
+// Fans around one vertex at a time and moves to the cached neighbour whose
+// remaining triangles still fit in the cache. Every fan that had to restart
+// from the dead-end stack begins a hard cluster, their first triangles go to
+// cluster_starts.
+static bool mesh_tipsify(u32 *dst, const u32 *indices, u32 index_cnt, u32 vert_cnt, u32 *cluster_starts, u32 *cluster_cnt, Arena *arena) {
+    const u32 tri_cnt = index_cnt / 3;
+    u32 *const offsets = ARENA_MAKE(arena, u32, vert_cnt + 1);
+    u32 *const live = ARENA_MAKE(arena, u32, vert_cnt);
+    u32 *const timestamps = ARENA_MAKE(arena, u32, vert_cnt);
+    u32 *const adjacency = ARENA_MAKE(arena, u32, index_cnt);
+    u32 *const dead_end = ARENA_MAKE(arena, u32, index_cnt);
+    bool *const emitted = ARENA_MAKE(arena, bool, tri_cnt);
+    if (!offsets || !live || !timestamps || !adjacency || !dead_end || !emitted) {
+        return false;
+    }
+    memset(live, 0, sizeof(u32) * vert_cnt);
+    memset(emitted, 0, sizeof(bool) * tri_cnt);
+    for (u32 i=0; i<index_cnt; i++) {
+        live[indices[i]]++;
+    }
+    // triangles of each vertex, timestamps double as the fill cursors
+    u32 offset = 0;
+    for (u32 vert=0; vert<vert_cnt; vert++) {
+        offsets[vert] = offset;
+        timestamps[vert] = offset;
+        offset += live[vert];
+    }
+    offsets[vert_cnt] = offset;
+    for (u32 i=0; i<index_cnt; i++) {
+        adjacency[timestamps[indices[i]]++] = i / 3;
+    }
+    memset(timestamps, 0, sizeof(u32) * vert_cnt);
+
+    u32 time = MESH_OPT_CACHE_SIZE + 1;
+    u32 dead_end_size = 0;
+    u32 cursor = 0;
+    u32 out = 0;
+    *cluster_cnt = 0;
+    u32 fan = mesh_tipsify_skip_dead_end(live, dead_end, &dead_end_size, &cursor, vert_cnt);
+    bool restarted = true;
+    while (fan != MESH_OPT_NONE) {
+        if (restarted) {
+            cluster_starts[(*cluster_cnt)++] = out / 3;
+        }
+        const u32 fan_start = out;
+        for (u32 i=offsets[fan]; i<offsets[fan + 1]; i++) {
+            const u32 tri = adjacency[i];
+            if (emitted[tri]) {
+                continue;
+            }
+            for (u32 k=0; k<3; k++) {
+                const u32 vert = indices[tri * 3 + k];
+                dst[out++] = vert;
+                dead_end[dead_end_size++] = vert;
+                live[vert]--;
+                if (time - timestamps[vert] > MESH_OPT_CACHE_SIZE) {
+                    timestamps[vert] = time++;
+                }
+            }
+            emitted[tri] = true;
+        }
+        // the fan's vertices are the candidates, prefer the oldest one that
+        // stays cached while its remaining triangles are emitted
+        fan = MESH_OPT_NONE;
+        i64 best = -1;
+        for (u32 i=fan_start; i<out; i++) {
+            const u32 vert = dst[i];
+            if (!live[vert]) {
+                continue;
+            }
+            const u32 age = time - timestamps[vert];
+            const i64 priority = age + 2 * live[vert] <= MESH_OPT_CACHE_SIZE ? age : 0;
+            if (priority > best) {
+                best = priority;
+                fan = vert;
+            }
+        }
+        restarted = fan == MESH_OPT_NONE;
+        if (restarted) {
+            fan = mesh_tipsify_skip_dead_end(live, dead_end, &dead_end_size, &cursor, vert_cnt);
+        }
+    }
+    MY_ASSERT(out == tri_cnt * 3);
+    return true;
+}
+
+// outward facing clusters far from the center occlude more, they go first
+static int mesh_cluster_cmp(const void *a, const void *b) {
+    const MeshCluster *const x = a;
+    const MeshCluster *const y = b;
+    if (x->sort_key != y->sort_key) {
+        return x->sort_key > y->sort_key ? -1 : 1;
+    }
+    return x->first_tri < y->first_tri ? -1 : (x->first_tri > y->first_tri);
+}
+
+// returns twice the area, the centroid is weighted by it and the normal has it as length
+static f32 mesh_triangle_geometry(const Vertex *verts, const u32 tri[static 3], f32 centroid[static 3], f32 normal[static 3]) {
+    const f32 *const p0 = verts[tri[0]].coord;
+    const f32 *const p1 = verts[tri[1]].coord;
+    const f32 *const p2 = verts[tri[2]].coord;
+    const f32 e1[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+    const f32 e2[3] = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+    normal[0] = e1[1] * e2[2] - e1[2] * e2[1];
+    normal[1] = e1[2] * e2[0] - e1[0] * e2[2];
+    normal[2] = e1[0] * e2[1] - e1[1] * e2[0];
+    const f32 area = sqrtf(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+    for (u32 axis=0; axis<3; axis++) {
+        centroid[axis] = (p0[axis] + p1[axis] + p2[axis]) / 3 * area;
+    }
+    return area;
+}
+
+// Cuts the hard clusters further where a prefix already has close to the
+// cluster's ACMR, then sorts the clusters by how much they face away from
+// the mesh center.
+static bool mesh_sort_overdraw(u32 *dst, const u32 *src, u32 index_cnt, const Vertex *verts, u32 vert_cnt, const u32 *hard_starts, u32 hard_cnt, Arena *arena) {
+    const u32 tri_cnt = index_cnt / 3;
+    MeshCluster *const clusters = ARENA_MAKE(arena, MeshCluster, tri_cnt);
+    u32 *const timestamps = ARENA_MAKE(arena, u32, vert_cnt);
+    if (!clusters || !timestamps) {
+        return false;
+    }
+    memset(timestamps, 0, sizeof(u32) * vert_cnt);
+    u32 time = MESH_OPT_CACHE_SIZE + 1;
+    u32 cluster_cnt = 0;
+    for (u32 hard=0; hard<hard_cnt; hard++) {
+        const u32 first = hard_starts[hard];
+        const u32 end = hard + 1 < hard_cnt ? hard_starts[hard + 1] : tri_cnt;
+        time += MESH_OPT_CACHE_SIZE + 1;
+        u32 misses = 0;
+        for (u32 tri=first; tri<end; tri++) {
+            misses += mesh_cache_triangle(timestamps, &time, MESH_OPT_CACHE_SIZE, &src[tri * 3]);
+        }
+        const f32 threshold = (f32)misses / (f32)(end - first) * MESH_OPT_OVERDRAW_THRESHOLD;
+        time += MESH_OPT_CACHE_SIZE + 1;
+        u32 start = first;
+        misses = 0;
+        for (u32 tri=first; tri<end; tri++) {
+            misses += mesh_cache_triangle(timestamps, &time, MESH_OPT_CACHE_SIZE, &src[tri * 3]);
+            if (tri + 1 == end || (f32)misses <= threshold * (f32)(tri + 1 - start)) {
+                clusters[cluster_cnt++] = (MeshCluster) { .first_tri = start, .tri_cnt = tri + 1 - start };
+                start = tri + 1;
+                misses = 0;
+                time += MESH_OPT_CACHE_SIZE + 1;
+            }
+        }
+    }
+
+    f32 mesh_centroid[3] = { 0 };
+    f32 mesh_area = 0;
+    for (u32 tri=0; tri<tri_cnt; tri++) {
+        f32 centroid[3], normal[3];
+        mesh_area += mesh_triangle_geometry(verts, &src[tri * 3], centroid, normal);
+        for (u32 axis=0; axis<3; axis++) {
+            mesh_centroid[axis] += centroid[axis];
+        }
+    }
+    for (u32 axis=0; axis<3; axis++) {
+        mesh_centroid[axis] = mesh_area > 0 ? mesh_centroid[axis] / mesh_area : 0;
+    }
+    for (u32 i=0; i<cluster_cnt; i++) {
+        MeshCluster *const cluster = &clusters[i];
+        f32 cluster_centroid[3] = { 0 };
+        f32 cluster_normal[3] = { 0 };
+        f32 cluster_area = 0;
+        for (u32 tri=cluster->first_tri; tri<cluster->first_tri + cluster->tri_cnt; tri++) {
+            f32 centroid[3], normal[3];
+            cluster_area += mesh_triangle_geometry(verts, &src[tri * 3], centroid, normal);
+            for (u32 axis=0; axis<3; axis++) {
+                cluster_centroid[axis] += centroid[axis];
+                cluster_normal[axis] += normal[axis];
+            }
+        }
+        const f32 normal_len = sqrtf(cluster_normal[0] * cluster_normal[0] + cluster_normal[1] * cluster_normal[1] + cluster_normal[2] * cluster_normal[2]);
+        cluster->sort_key = 0;
+        if (normal_len > 0) {
+            for (u32 axis=0; axis<3; axis++) {
+                cluster->sort_key += (cluster_centroid[axis] / cluster_area - mesh_centroid[axis]) * cluster_normal[axis] / normal_len;
+            }
+        }
+    }
+    qsort(clusters, cluster_cnt, sizeof(MeshCluster), mesh_cluster_cmp);
+    u32 out = 0;
+    for (u32 i=0; i<cluster_cnt; i++) {
+        memcpy(&dst[out], &src[clusters[i].first_tri * 3], sizeof(u32) * 3 * clusters[i].tri_cnt);
+        out += clusters[i].tri_cnt * 3;
+    }
+    MY_ASSERT(out == index_cnt);
+    return true;
+}
+
+bool mesh_optimize(Vertex *verts, u32 vert_cnt, u32 *indices, u32 index_cnt, MeshOptStats *stats) {
+    MY_ASSERT(index_cnt % 3 == 0);
+    const MeshCacheStats before = mesh_cache_stats(indices, index_cnt, vert_cnt, MESH_OPT_CACHE_SIZE);
+    if (stats) {
+        *stats = (MeshOptStats) { .before = before, .after = before };
+    }
+    if (!index_cnt) {
+        return true;
+    }
+    ArenaTemp scratch = arena_scratch_begin(NULL);
+    const u32 tri_cnt = index_cnt / 3;
+    u32 *const tipsified = ARENA_MAKE(scratch.arena, u32, index_cnt);
+    u32 *const sorted = ARENA_MAKE(scratch.arena, u32, index_cnt);
+    u32 *const cluster_starts = ARENA_MAKE(scratch.arena, u32, tri_cnt);
+    u32 *const remap = ARENA_MAKE(scratch.arena, u32, vert_cnt);
+    Vertex *const remapped = ARENA_MAKE(scratch.arena, Vertex, vert_cnt);
+    u32 cluster_cnt;
+    if (!tipsified || !sorted || !cluster_starts || !remap || !remapped
+        || !mesh_tipsify(tipsified, indices, index_cnt, vert_cnt, cluster_starts, &cluster_cnt, scratch.arena)
+        || !mesh_sort_overdraw(sorted, tipsified, index_cnt, verts, vert_cnt, cluster_starts, cluster_cnt, scratch.arena)) {
+        arena_scratch_end(scratch);
+        return false;
+    }
+    // first use order, unused vertices keep their relative order at the end
+    memset(remap, 0xff, sizeof(u32) * vert_cnt);
+    u32 next = 0;
+    for (u32 i=0; i<index_cnt; i++) {
+        if (remap[sorted[i]] == MESH_OPT_NONE) {
+            remap[sorted[i]] = next++;
+        }
+    }
+    for (u32 vert=0; vert<vert_cnt; vert++) {
+        if (remap[vert] == MESH_OPT_NONE) {
+            remap[vert] = next++;
+        }
+        remapped[remap[vert]] = verts[vert];
+    }
+    memcpy(verts, remapped, sizeof(Vertex) * vert_cnt);
+    for (u32 i=0; i<index_cnt; i++) {
+        indices[i] = remap[sorted[i]];
+    }
+    arena_scratch_end(scratch);
+    if (stats) {
+        stats->after = mesh_cache_stats(indices, index_cnt, vert_cnt, MESH_OPT_CACHE_SIZE);
+    }
+    return true;
+}
@@ -0,0 +1,198 @@
+#include "render_queue.h"
+
+#include <string.h>
+
+u64 render_key(const RenderItem *item, u32 program_id, u32 mesh_id) {
+    MY_ASSERT(item->layer < (1u << RENDER_KEY_LAYER_BITS));
+    MY_ASSERT(program_id < (1u << RENDER_KEY_PROGRAM_BITS));
+    MY_ASSERT(item->material < (1u << RENDER_KEY_MATERIAL_BITS));
+    MY_ASSERT(mesh_id < (1u << RENDER_KEY_MESH_BITS));
+    // non-negative floats order like their bit patterns, the top bits keep
+    // the exponent and the high mantissa bits
+    const f32 depth = item->depth > 0 ? item->depth : 0;
+    u32 depth_bits;
+    memcpy(&depth_bits, &depth, sizeof(depth_bits));
+    const u64 depth_mask = (1ull << RENDER_KEY_DEPTH_BITS) - 1;
+    const u64 depth_key = depth_bits >> (32 - RENDER_KEY_DEPTH_BITS);
+    const u64 state = ((u64)program_id << (RENDER_KEY_MATERIAL_BITS + RENDER_KEY_MESH_BITS))
+                    | ((u64)item->material << RENDER_KEY_MESH_BITS)
+                    | mesh_id;
+    const u64 key = (u64)item->layer << (64 - RENDER_KEY_LAYER_BITS);
+    if (item->translucent) {
+        return key | (1ull << (63 - RENDER_KEY_LAYER_BITS)) | ((~depth_key & depth_mask) << (64 - RENDER_KEY_LAYER_BITS - 1 - RENDER_KEY_DEPTH_BITS)) | state;
+    }
+    return key | (state << RENDER_KEY_DEPTH_BITS) | depth_key;
+}
+
+void render_queue_begin(RenderQueue *queue, Arena *arena) {
+    *queue = (RenderQueue) { .arena = arena };
+    render_id_map_init(&queue->programs, (AllocatorPoly)ARENA_POLY(arena));
+    render_id_map_init(&queue->meshes, (AllocatorPoly)ARENA_POLY(arena));
+}
+
+// ids are handed out in first seen order, UINT32_MAX when the key's bits have no room left
+static u32 render_queue_compact_id(RenderIdMap *ids, u32 value, u32 bits) {
+    const u32 *const found = render_id_map_get(ids, value);
+    if (found) {
+        return *found;
+    }
+    if (ids->size == 1u << bits) {
+        return UINT32_MAX;
+    }
+    const u32 *const id = render_id_map_put(ids, value, ids->size);
+    return id ? *id : UINT32_MAX;
+}
+
+bool render_queue_reserve(RenderQueue *queue, u32 cap) {
+    if (cap <= queue->cap) {
+        return true;
+    }
+    RenderCommand *const cmds = arena_realloc(queue->arena, queue->cmds, sizeof(RenderCommand) * queue->cap, sizeof(RenderCommand) * cap, alignof(RenderCommand));
+    if (!cmds) return false;
+    queue->cmds = cmds;
+    RenderSortEntry *const entries = arena_realloc(queue->arena, queue->entries, sizeof(RenderSortEntry) * queue->cap, sizeof(RenderSortEntry) * cap, alignof(RenderSortEntry));
+    if (!entries) return false;
+    queue->entries = entries;
+    queue->cap = cap;
+    return true;
+}
+
+bool render_queue_push(RenderQueue *queue, const RenderItem *item) {
+    if (queue->size == queue->cap && !render_queue_reserve(queue, queue->cap ? queue->cap * 2 : 64)) {
+        queue->dropped++;
+        return false;
+    }
+    if (item->layer >= 1u << RENDER_KEY_LAYER_BITS || item->material >= 1u << RENDER_KEY_MATERIAL_BITS) {
+        queue->dropped++;
+        return false;
+    }
+    const u32 program_id = render_queue_compact_id(&queue->programs, item->program, RENDER_KEY_PROGRAM_BITS);
+    const u32 mesh_id = render_queue_compact_id(&queue->meshes, item->mesh.index, RENDER_KEY_MESH_BITS);
+    if (program_id == UINT32_MAX || mesh_id == UINT32_MAX) {
+        queue->dropped++;
+        return false;
+    }
+    queue->cmds[queue->size] = (RenderCommand) {
+        .mesh = item->mesh,
+        .program = item->program,
+        .material = item->material,
+        .translucent = item->translucent,
+        .transform = item->transform,
+        .tint = item->tint,
+    };
+    queue->entries[queue->size] = (RenderSortEntry) { .key = render_key(item, program_id, mesh_id), .index = queue->size };
+    queue->size++;
+    return true;
+}
+
+// LSD radix sort on bytes, stable; passes where every key has the same byte
+// are skipped. Returns whichever of src and dst holds the result.
+static RenderSortEntry* render_sort(RenderSortEntry *src, RenderSortEntry *dst, u32 n) {
+    u32 counts[sizeof(u64)][256] = { 0 };
+    for (u32 i=0; i<n; i++) {
+        for (u32 byte=0; byte<sizeof(u64); byte++) {
+            counts[byte][(src[i].key >> (byte * 8)) & 0xff]++;
+        }
+    }
+    for (u32 byte=0; byte<sizeof(u64); byte++) {
+        u32 *const count = counts[byte];
+        const u32 shift = byte * 8;
+        if (count[(src[0].key >> shift) & 0xff] == n) {
+            continue;
+        }
+        u32 offset = 0;
+        for (u32 digit=0; digit<256; digit++) {
+            const u32 digit_cnt = count[digit];
+            count[digit] = offset;
+            offset += digit_cnt;
+        }
+        for (u32 i=0; i<n; i++) {
+            dst[count[(src[i].key >> shift) & 0xff]++] = src[i];
+        }
+        RenderSortEntry *const tmp = src;
+        src = dst;
+        dst = tmp;
+    }
+    return src;
+}
+
+static void render_set_translucent(bool translucent) {
+    gl_set_capability(GL_BLEND, translucent);
+    // translucent draws test against depth but leave it for what is behind them
+    gl_set_depth_mask(!translucent);
+    if (translucent) {
+        gl_set_blend_func(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    }
+}
+
+static void render_queue_flush(GlBatch *batch, RenderQueueStats *stats) {
+    const u32 draws = gl_batch_submit(batch);
+    if (!draws) {
+        stats->dropped += batch->size;
+    }
+    stats->draws += draws;
+    stats->batches++;
+    gl_batch_clear(batch);
+}
+
+RenderQueueStats render_queue_submit(RenderQueue *queue, RenderBindFn *bind, void *bind_ctx) {
+    RenderQueueStats stats = { .cmd_cnt = queue->size, .dropped = queue->dropped };
+    if (!queue->size) {
+        return stats;
+    }
+    ArenaTemp temp = arena_temp_begin(queue->arena);
+    RenderSortEntry *const tmp = ARENA_MAKE(temp.arena, RenderSortEntry, queue->size);
+    if (!tmp) {
+        arena_temp_end(temp);
+        stats.dropped += queue->size;
+        return stats;
+    }
+    const RenderSortEntry *const sorted = render_sort(queue->entries, tmp, queue->size);
+    // one batch storage for the whole queue, reused by every flush
+    GlBatch batch;
+    gl_batch_begin(&batch, temp.arena);
+    if (!gl_batch_reserve(&batch, queue->size)) {
+        arena_temp_end(temp);
+        stats.dropped += queue->size;
+        return stats;
+    }
+    const RenderCommand *prev = NULL;
+    u64 prev_layer = 0;
+    for (u32 i=0; i<queue->size; i++) {
+        const RenderCommand *const cmd = &queue->cmds[sorted[i].index];
+        const u64 layer = sorted[i].key >> (64 - RENDER_KEY_LAYER_BITS);
+        const GlVertexFormat format = gl_mesh_get_data(cmd->mesh)->format;
+        const bool state_change = !prev || cmd->program != prev->program || cmd->material != prev->material;
+        // a batch draws mesh by mesh, so translucent ones must not mix meshes to keep their order
+        const bool flush = batch.size && (state_change || layer != prev_layer
+            || cmd->translucent != prev->translucent || !gl_vertex_formats_share_pool(format, batch.format)
+            || (cmd->translucent && cmd->mesh.index != prev->mesh.index));
+        if (flush) {
+            render_queue_flush(&batch, &stats);
+        }
+        if (!prev || cmd->translucent != prev->translucent) {
+            render_set_translucent(cmd->translucent);
+        }
+        if (state_change) {
+            gl_use_program(cmd->program);
+            if (bind) {
+                bind(bind_ctx, cmd->program, cmd->material);
+            }
+            stats.state_changes++;
+        }
+        // cannot fail while the batch holds the whole queue
+        const bool added = gl_batch_add(&batch, cmd->mesh, cmd->transform, cmd->tint);
+        MY_ASSERT(added);
+        UNUSED(added);
+        prev = cmd;
+        prev_layer = layer;
+    }
+    if (batch.size) {
+        render_queue_flush(&batch, &stats);
+    }
+    if (prev && prev->translucent) {
+        render_set_translucent(false);
+    }
+    arena_temp_end(temp);
+    return stats;
+}
@@ -9,6 +9,8 @@
 
 #include "common.h"
 #include "arena.h"
+#include "gl.h"
+#include "hash_map.h"
 
 static i64 read_whole_file(int fd, Arena *arena, StringView *content) {
     struct stat stat;
@@ -23,14 +25,18 @@ static i64 read_whole_file(int fd, Arena *arena, StringView *content) {
 
 GLint64 compile_shader_from_file(int fd, GLenum shader_type, Arena *arena, StringView *log) {
     lseek(fd, 0, SEEK_SET);
+    // source text is only needed until glShaderSource copies it
+    ArenaTemp scratch = arena_scratch_begin(arena);
     StringView shader_source;
-    i64 read = read_whole_file(fd, arena, &shader_source);
+    i64 read = read_whole_file(fd, scratch.arena, &shader_source);
     if (read < 0) {
+        arena_scratch_end(scratch);
         return -1;
     }
     const char* source[] = { (const char*)shader_source.data };
     const GLuint shader = glCreateShader(shader_type);
     glShaderSource(shader, 1, source, NULL);
+    arena_scratch_end(scratch);
     glCompileShader(shader);
     GLint success;
     glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
@@ -57,6 +63,74 @@ static ShaderMgrError shader_info_init(ShaderInfo *shader, StringView path, GLen
     return SHADER_MGR_ERROR_NONE;
 }
 
+ShaderName shader_mgr_intern(ShaderMgr *mgr, StringView name) {
+    const ShaderName *const found = shader_name_map_get(&mgr->name_map, name);
+    if (found) {
+        return *found;
+    }
+    if (mgr->name_cnt == SHADER_MGR_MAX_NAMES || SHADER_MGR_NAME_BUF_SIZE - mgr->name_buf_size < name.size + 1) {
+        return SHADER_NAME_NONE;
+    }
+    char *const data = mgr->name_buf + mgr->name_buf_size;
+    memcpy(data, name.data, name.size);
+    data[name.size] = 0;
+    mgr->name_buf_size += name.size + 1;
+    const ShaderName id = mgr->name_cnt++;
+    mgr->names[id] = (StringView) { .data = data, .size = name.size };
+    // cannot fail, the map was reserved for SHADER_MGR_MAX_NAMES
+    shader_name_map_put(&mgr->name_map, mgr->names[id], id);
+    mgr->vars[id] = (ShaderVar) { .location = -1 };
+    return id;
+}
+
+static void shader_mgr_reflect_var(ShaderMgr *mgr, char *name, GLsizei len, ShaderVarKind kind, GLint location, GLenum type, GLint size) {
+    // arrays are reported as name[0], they are interned without the subscript
+    if (len > 3 && memcmp(name + len - 3, "[0]", 3) == 0) {
+        len -= 3;
+    }
+    const ShaderName id = shader_mgr_intern(mgr, (StringView) { .data = name, .size = len });
+    if (id == SHADER_NAME_NONE) {
+        return;
+    }
+    mgr->vars[id] = (ShaderVar) { .kind = kind, .location = location, .type = type, .size = size };
+}
+
+// a new program starts with default values, so the cached ones are dropped too
+static void shader_mgr_reflect(ShaderMgr *mgr) {
+    for (u32 i=0; i<mgr->name_cnt; i++) {
+        mgr->vars[i] = (ShaderVar) { .location = -1 };
+    }
+    char name[256];
+    GLsizei len;
+    GLint size;
+    GLenum type;
+    GLint cnt;
+    glGetProgramiv(mgr->prog, GL_ACTIVE_UNIFORMS, &cnt);
+    for (GLint i=0; i<cnt; i++) {
+        glGetActiveUniform(mgr->prog, i, sizeof(name), &len, &size, &type, name);
+        const GLint location = glGetUniformLocation(mgr->prog, name);
+        // block members have no location, they are set through the block's buffer
+        if (location >= 0) {
+            shader_mgr_reflect_var(mgr, name, len, SHADER_VAR_UNIFORM, location, type, size);
+        }
+    }
+    glGetProgramiv(mgr->prog, GL_ACTIVE_ATTRIBUTES, &cnt);
+    for (GLint i=0; i<cnt; i++) {
+        glGetActiveAttrib(mgr->prog, i, sizeof(name), &len, &size, &type, name);
+        const GLint location = glGetAttribLocation(mgr->prog, name);
+        // built-ins such as gl_VertexID have no location
+        if (location >= 0) {
+            shader_mgr_reflect_var(mgr, name, len, SHADER_VAR_ATTRIB, location, type, size);
+        }
+    }
+    glGetProgramiv(mgr->prog, GL_ACTIVE_UNIFORM_BLOCKS, &cnt);
+    for (GLint i=0; i<cnt; i++) {
+        glGetActiveUniformBlockName(mgr->prog, i, sizeof(name), &len, name);
+        glGetActiveUniformBlockiv(mgr->prog, i, GL_UNIFORM_BLOCK_DATA_SIZE, &size);
+        shader_mgr_reflect_var(mgr, name, len, SHADER_VAR_BLOCK, i, GL_UNIFORM_BLOCK, size);
+    }
+}
+
 static ShaderMgrError shader_mgr_init_impl(ShaderMgr *mgr, ShaderInfo vertex, ShaderInfo fragment) {
     mgr->inotify_fd = inotify_init();
     if (mgr->inotify_fd < 0) {
@@ -75,6 +149,15 @@ static ShaderMgrError shader_mgr_init_impl(ShaderMgr *mgr, ShaderInfo vertex, Sh
     mgr->vertex = vertex;
     mgr->fragment = fragment;
     mgr->have_prog = false;
+    mgr->name_buf_size = 0;
+    mgr->name_cnt = 0;
+    arena_init(&mgr->name_map_arena, mgr->name_map_buf, sizeof(mgr->name_map_buf));
+    shader_name_map_init(&mgr->name_map, (AllocatorPoly)ARENA_POLY(&mgr->name_map_arena));
+    const bool reserved = shader_name_map_reserve(&mgr->name_map, SHADER_MGR_NAME_MAP_CAP);
+    MY_ASSERT(reserved);
+    UNUSED(reserved);
+    mgr->upload_cnt = 0;
+    mgr->upload_skip_cnt = 0;
     return SHADER_MGR_ERROR_NONE;
 }
 
@@ -118,6 +201,7 @@ ShaderMgrError shader_mgr_get_program(ShaderMgr *mgr, GLuint *prog, Arena *arena
     }
     *prog = mgr->prog;
     mgr->have_prog = prog;
+    shader_mgr_reflect(mgr);
     return SHADER_MGR_ERROR_NONE;
 }
 
@@ -125,21 +209,22 @@ ShaderMgrError shader_mgr_reload_if_needed(ShaderMgr *mgr, bool *reloaded, Arena
     enum { BUF_SIZE = sizeof(struct inotify_event) + NAME_MAX + 1  };
     u8 buf[BUF_SIZE];
     *reloaded = false;
+    // drain the events first, a save often fires several and each reload
+    // relinks and reflects the program
+    bool modified = false;
     for (;;) {
         int len = read(mgr->inotify_fd, buf, sizeof(buf));
         if (len <= 0) break;
-        const struct inotify_event *event;
-        // FIXME: reloads EVERY shader for EVERY inotify event
-        for (u8 *ptr = buf; ptr < buf + len;
-            ptr += sizeof(struct inotify_event) + event->len) {
-            event = (const struct inotify_event*)(buf);
-            ShaderMgrError err = shader_mgr_reload_shaders(mgr, arena, log);
-            if (err != 0) {
-                return err;
-            }
-            *reloaded = true;
-        }
+        modified = true;
+    }
+    if (!modified) {
+        return 0;
     }
+    ShaderMgrError err = shader_mgr_reload_shaders(mgr, arena, log);
+    if (err != 0) {
+        return err;
+    }
+    *reloaded = true;
     return 0;
 }
 
@@ -158,25 +243,148 @@ ShaderMgrError shader_mgr_reload_shaders(ShaderMgr *mgr, Arena *arena, StringVie
     glAttachShader(prog_tmp, tmp_frag);
     glLinkProgram(prog_tmp);
     GLint success;
-    glGetProgramiv(mgr->prog, GL_LINK_STATUS, &success);
+    glGetProgramiv(prog_tmp, GL_LINK_STATUS, &success);
     if (!success) {
         GLint log_length;
-        glGetProgramiv(mgr->prog, GL_INFO_LOG_LENGTH, &log_length);
+        glGetProgramiv(prog_tmp, GL_INFO_LOG_LENGTH, &log_length);
         log->size = log_length + 1;
         log->data = ARENA_MAKE(arena, char, log->size);
         log->data[log_length] = 0;
-        glGetProgramInfoLog(mgr->prog, log_length, NULL, (char*)log->data);
+        glGetProgramInfoLog(prog_tmp, log_length, NULL, (char*)log->data);
         return SHADER_MGR_ERROR_LINK_PROGRAM;
     }
 
     glDeleteShader(mgr->vertex.shader);
     glDeleteShader(mgr->fragment.shader);
-    glUseProgram(prog_tmp);
+    // through the cache, a raw bind would leave it naming the deleted program
+    gl_use_program(prog_tmp);
     glDeleteProgram(mgr->prog);
     mgr->prog = prog_tmp;
+    shader_mgr_reflect(mgr);
 
     mgr->vertex.shader = tmp_vert;
     mgr->fragment.shader = tmp_frag;
     return 0;
 }
 
+const ShaderVar* shader_mgr_var(const ShaderMgr *mgr, ShaderName name) {
+    MY_ASSERT(name < mgr->name_cnt);
+    return &mgr->vars[name];
+}
+
+GLint shader_mgr_uniform_location(const ShaderMgr *mgr, ShaderName name) {
+    const ShaderVar *const var = shader_mgr_var(mgr, name);
+    return var->kind == SHADER_VAR_UNIFORM ? var->location : -1;
+}
+
+GLint shader_mgr_attrib_location(const ShaderMgr *mgr, ShaderName name) {
+    const ShaderVar *const var = shader_mgr_var(mgr, name);
+    return var->kind == SHADER_VAR_ATTRIB ? var->location : -1;
+}
+
+GLuint shader_mgr_block_index(const ShaderMgr *mgr, ShaderName name) {
+    const ShaderVar *const var = shader_mgr_var(mgr, name);
+    return var->kind == SHADER_VAR_BLOCK ? (GLuint)var->location : GL_INVALID_INDEX;
+}
+
+// glUniform1i sets ints, bools and sampler units
+static bool shader_var_takes_int(GLenum type) {
+    switch (type) {
+        case GL_INT:
+        case GL_BOOL:
+        case GL_SAMPLER_1D:
+        case GL_SAMPLER_2D:
+        case GL_SAMPLER_3D:
+        case GL_SAMPLER_CUBE:
+        case GL_SAMPLER_1D_SHADOW:
+        case GL_SAMPLER_2D_SHADOW:
+        case GL_SAMPLER_1D_ARRAY:
+        case GL_SAMPLER_2D_ARRAY:
+        case GL_SAMPLER_1D_ARRAY_SHADOW:
+        case GL_SAMPLER_2D_ARRAY_SHADOW:
+        case GL_SAMPLER_2D_MULTISAMPLE:
+        case GL_SAMPLER_2D_MULTISAMPLE_ARRAY:
+        case GL_SAMPLER_CUBE_SHADOW:
+        case GL_SAMPLER_BUFFER:
+        case GL_SAMPLER_2D_RECT:
+        case GL_SAMPLER_2D_RECT_SHADOW:
+        case GL_INT_SAMPLER_1D:
+        case GL_INT_SAMPLER_2D:
+        case GL_INT_SAMPLER_3D:
+        case GL_INT_SAMPLER_CUBE:
+        case GL_INT_SAMPLER_1D_ARRAY:
+        case GL_INT_SAMPLER_2D_ARRAY:
+        case GL_INT_SAMPLER_2D_MULTISAMPLE:
+        case GL_INT_SAMPLER_2D_MULTISAMPLE_ARRAY:
+        case GL_INT_SAMPLER_BUFFER:
+        case GL_INT_SAMPLER_2D_RECT:
+        case GL_UNSIGNED_INT_SAMPLER_1D:
+        case GL_UNSIGNED_INT_SAMPLER_2D:
+        case GL_UNSIGNED_INT_SAMPLER_3D:
+        case GL_UNSIGNED_INT_SAMPLER_CUBE:
+        case GL_UNSIGNED_INT_SAMPLER_1D_ARRAY:
+        case GL_UNSIGNED_INT_SAMPLER_2D_ARRAY:
+        case GL_UNSIGNED_INT_SAMPLER_2D_MULTISAMPLE:
+        case GL_UNSIGNED_INT_SAMPLER_2D_MULTISAMPLE_ARRAY:
+        case GL_UNSIGNED_INT_SAMPLER_BUFFER:
+        case GL_UNSIGNED_INT_SAMPLER_2D_RECT:
+            return true;
+        default:
+            return false;
+    }
+}
+
+// type is the GLSL type the value is uploaded as, GL_INT also covers samplers and bools
+static void shader_mgr_upload(ShaderMgr *mgr, ShaderName name, GLenum type, const void *value, u32 size) {
+    MY_ASSERT(name < mgr->name_cnt);
+    ShaderVar *const var = &mgr->vars[name];
+    if (var->kind != SHADER_VAR_UNIFORM) {
+        return;
+    }
+    // a mismatched upload is a GL error, it is dropped in release builds
+    const bool type_ok = type == GL_INT ? shader_var_takes_int(var->type) : var->type == type;
+    MY_ASSERT(type_ok && "Uniform set with the wrong type");
+    if (!type_ok) {
+        return;
+    }
+    if (var->has_value && memcmp(var->value, value, size) == 0) {
+        mgr->upload_skip_cnt++;
+        return;
+    }
+    memcpy(var->value, value, size);
+    var->has_value = true;
+    mgr->upload_cnt++;
+    switch (type) {
+        case GL_INT:
+            glUniform1iv(var->location, 1, value);
+            break;
+        case GL_FLOAT:
+            glUniform1fv(var->location, 1, value);
+            break;
+        case GL_FLOAT_VEC4:
+            glUniform4fv(var->location, 1, value);
+            break;
+        case GL_FLOAT_MAT4:
+            glUniformMatrix4fv(var->location, 1, GL_FALSE, value);
+            break;
+        default:
+            UNREACHABLE("Unhandled uniform type");
+    }
+}
+
+void shader_mgr_set_int(ShaderMgr *mgr, ShaderName name, i32 value) {
+    shader_mgr_upload(mgr, name, GL_INT, &value, sizeof(value));
+}
+
+void shader_mgr_set_float(ShaderMgr *mgr, ShaderName name, f32 value) {
+    shader_mgr_upload(mgr, name, GL_FLOAT, &value, sizeof(value));
+}
+
+void shader_mgr_set_vec4(ShaderMgr *mgr, ShaderName name, const f32 value[static 4]) {
+    shader_mgr_upload(mgr, name, GL_FLOAT_VEC4, value, sizeof(f32) * 4);
+}
+
+void shader_mgr_set_mat4(ShaderMgr *mgr, ShaderName name, const f32 value[static 16]) {
+    shader_mgr_upload(mgr, name, GL_FLOAT_MAT4, value, sizeof(f32) * 16);
+}
+
@@ -0,0 +1,317 @@
+#include "tlsf.h"
+
+#include <string.h>
+
+// Physical layout of a block: [prev_phys | size | payload...].
+// next_free/prev_free overlay the first bytes of the payload and are only
+// meaningful while the block is free. The region ends with a zero-sized
+// used sentinel so merging never walks past it.
+struct TlsfBlock {
+    TlsfBlock *prev_phys;
+    size_t size;
+    TlsfBlock *next_free;
+    TlsfBlock *prev_free;
+};
+
+enum { TLSF_BLOCK_FREE_BIT = 1 };
+enum { TLSF_BLOCK_HEADER = offsetof(TlsfBlock, next_free) };
+enum { TLSF_BLOCK_MIN = sizeof(TlsfBlock) - TLSF_BLOCK_HEADER };
+enum { TLSF_SMALL_BLOCK = 1 << TLSF_FL_SHIFT };
+static_assert(TLSF_BLOCK_HEADER % TLSF_ALIGN == 0);
+static_assert(TLSF_BLOCK_MIN % TLSF_ALIGN == 0);
+
+static inline u32 tlsf_fls(size_t x) {
+    return 63 - __builtin_clzll(x);
+}
+
+static inline u32 tlsf_ffs(u32 x) {
+    return __builtin_ctz(x);
+}
+
+static inline size_t block_size(const TlsfBlock *block) {
+    return block->size & ~(size_t)TLSF_BLOCK_FREE_BIT;
+}
+
+static inline bool block_is_free(const TlsfBlock *block) {
+    return block->size & TLSF_BLOCK_FREE_BIT;
+}
+
+static inline void block_set_size(TlsfBlock *block, size_t size) {
+    block->size = size | (block->size & TLSF_BLOCK_FREE_BIT);
+}
+
+static inline void block_set_free(TlsfBlock *block, bool free) {
+    block->size = free ? block->size | TLSF_BLOCK_FREE_BIT : block_size(block);
+}
+
+static inline u8* block_payload(const TlsfBlock *block) {
+    return (u8*)block + TLSF_BLOCK_HEADER;
+}
+
+static inline TlsfBlock* block_from_payload(const void *mem) {
+    return (TlsfBlock*)((u8*)mem - TLSF_BLOCK_HEADER);
+}
+
+static inline TlsfBlock* block_next(const TlsfBlock *block) {
+    return (TlsfBlock*)(block_payload(block) + block_size(block));
+}
+
+static void mapping_insert(size_t size, u32 *fl, u32 *sl) {
+    if (size < TLSF_SMALL_BLOCK) {
+        *fl = 0;
+        *sl = size / (TLSF_SMALL_BLOCK / TLSF_SL_COUNT);
+        return;
+    }
+    const u32 fls = tlsf_fls(size);
+    *sl = (size >> (fls - TLSF_SL_COUNT_LOG2)) ^ (1 << TLSF_SL_COUNT_LOG2);
+    *fl = fls - (TLSF_FL_SHIFT - 1);
+}
+
+// rounds size up to the next bin so any block found there is big enough
+static void mapping_search(size_t size, u32 *fl, u32 *sl) {
+    if (size >= TLSF_SMALL_BLOCK) {
+        size += ((size_t)1 << (tlsf_fls(size) - TLSF_SL_COUNT_LOG2)) - 1;
+    }
+    mapping_insert(size, fl, sl);
+}
+
+static TlsfBlock* search_suitable_block(Tlsf *tlsf, u32 *fl, u32 *sl) {
+    if (*fl >= TLSF_FL_COUNT) {
+        return NULL;
+    }
+    u32 sl_map = tlsf->sl_bitmap[*fl] & (~0u << *sl);
+    if (!sl_map) {
+        const u32 fl_map = *fl + 1 < 32 ? tlsf->fl_bitmap & (~0u << (*fl + 1)) : 0;
+        if (!fl_map) {
+            return NULL;
+        }
+        *fl = tlsf_ffs(fl_map);
+        sl_map = tlsf->sl_bitmap[*fl];
+    }
+    *sl = tlsf_ffs(sl_map);
+    return tlsf->blocks[*fl][*sl];
+}
+
+static void remove_free_block(Tlsf *tlsf, TlsfBlock *block, u32 fl, u32 sl) {
+    if (block->prev_free) {
+        block->prev_free->next_free = block->next_free;
+    }
+    if (block->next_free) {
+        block->next_free->prev_free = block->prev_free;
+    }
+    if (tlsf->blocks[fl][sl] == block) {
+        tlsf->blocks[fl][sl] = block->next_free;
+        if (!block->next_free) {
+            tlsf->sl_bitmap[fl] &= ~(1u << sl);
+            if (!tlsf->sl_bitmap[fl]) {
+                tlsf->fl_bitmap &= ~(1u << fl);
+            }
+        }
+    }
+}
+
+static void insert_free_block(Tlsf *tlsf, TlsfBlock *block) {
+    u32 fl, sl;
+    mapping_insert(block_size(block), &fl, &sl);
+    TlsfBlock *const head = tlsf->blocks[fl][sl];
+    block->next_free = head;
+    block->prev_free = NULL;
+    if (head) {
+        head->prev_free = block;
+    }
+    tlsf->blocks[fl][sl] = block;
+    tlsf->fl_bitmap |= 1u << fl;
+    tlsf->sl_bitmap[fl] |= 1u << sl;
+}
+
+static void block_remove(Tlsf *tlsf, TlsfBlock *block) {
+    u32 fl, sl;
+    mapping_insert(block_size(block), &fl, &sl);
+    remove_free_block(tlsf, block, fl, sl);
+}
+
+static bool block_can_split(const TlsfBlock *block, size_t size) {
+    return block_size(block) >= size + TLSF_BLOCK_HEADER + TLSF_BLOCK_MIN;
+}
+
+// cuts block down to size, returns the (unlinked) remainder
+static TlsfBlock* block_split(TlsfBlock *block, size_t size) {
+    TlsfBlock *const remaining = (TlsfBlock*)(block_payload(block) + size);
+    remaining->size = block_size(block) - size - TLSF_BLOCK_HEADER;
+    remaining->prev_phys = block;
+    block_set_size(block, size);
+    block_next(remaining)->prev_phys = remaining;
+    return remaining;
+}
+
+// absorbs the physically next block, which must already be unlinked
+static void block_absorb_next(TlsfBlock *block) {
+    const TlsfBlock *const next = block_next(block);
+    block_set_size(block, block_size(block) + TLSF_BLOCK_HEADER + block_size(next));
+    block_next(block)->prev_phys = block;
+}
+
+static TlsfBlock* block_merge_prev(Tlsf *tlsf, TlsfBlock *block) {
+    TlsfBlock *const prev = block->prev_phys;
+    if (!prev || !block_is_free(prev)) {
+        return block;
+    }
+    block_remove(tlsf, prev);
+    block_absorb_next(prev);
+    return prev;
+}
+
+static TlsfBlock* block_merge_next(Tlsf *tlsf, TlsfBlock *block) {
+    TlsfBlock *const next = block_next(block);
+    if (!block_is_free(next)) {
+        return block;
+    }
+    block_remove(tlsf, next);
+    block_absorb_next(block);
+    return block;
+}
+
+// gives the tail of a used block back to the free lists
+static void block_trim_used(Tlsf *tlsf, TlsfBlock *block, size_t size) {
+    if (!block_can_split(block, size)) {
+        return;
+    }
+    TlsfBlock *remaining = block_split(block, size);
+    block_set_free(remaining, true);
+    remaining = block_merge_next(tlsf, remaining);
+    insert_free_block(tlsf, remaining);
+}
+
+static size_t adjust_request_size(size_t size) {
+    size = align_forward(size, TLSF_ALIGN);
+    return size < TLSF_BLOCK_MIN ? TLSF_BLOCK_MIN : size;
+}
+
+bool tlsf_init(Tlsf *tlsf, u8 *buf, size_t buf_size) {
+    MY_ASSERT(buf);
+    u8 *const start = (u8*)align_forward((uintptr_t)buf, TLSF_ALIGN);
+    if ((size_t)(start - buf) + TLSF_BLOCK_HEADER * 2 + TLSF_BLOCK_MIN > buf_size) {
+        return false;
+    }
+    tlsf->buf = buf;
+    tlsf->size = buf_size;
+    tlsf->fl_bitmap = 0;
+    memset(tlsf->sl_bitmap, 0, sizeof(tlsf->sl_bitmap));
+    memset(tlsf->blocks, 0, sizeof(tlsf->blocks));
+
+    size_t usable = buf_size - (size_t)(start - buf) - TLSF_BLOCK_HEADER * 2;
+    usable &= ~(size_t)(TLSF_ALIGN - 1);
+    const size_t max_block = ((size_t)1 << TLSF_FL_MAX_LOG2) - 1;
+    usable = usable > max_block ? max_block & ~(size_t)(TLSF_ALIGN - 1) : usable;
+
+    TlsfBlock *const block = (TlsfBlock*)start;
+    block->prev_phys = NULL;
+    block->size = usable | TLSF_BLOCK_FREE_BIT;
+    TlsfBlock *const sentinel = block_next(block);
+    sentinel->prev_phys = block;
+    sentinel->size = 0;
+    insert_free_block(tlsf, block);
+    return true;
+}
+
+void tlsf_clear(Tlsf *tlsf) {
+    tlsf_init(tlsf, tlsf->buf, tlsf->size);
+}
+
+void* tlsf_alloc(Tlsf *tlsf, size_t size, size_t alignment) {
+    MY_ASSERT(is_power_of_two(alignment));
+    const size_t adjusted = adjust_request_size(size);
+    // over-aligned requests look for room to cut a free block off the front
+    const size_t gap_min = TLSF_BLOCK_HEADER + TLSF_BLOCK_MIN;
+    const size_t search_size = alignment > TLSF_ALIGN ? adjusted + alignment + gap_min : adjusted;
+
+    u32 fl, sl;
+    mapping_search(search_size, &fl, &sl);
+    TlsfBlock *block = search_suitable_block(tlsf, &fl, &sl);
+    if (!block) {
+        return NULL;
+    }
+    remove_free_block(tlsf, block, fl, sl);
+
+    if (alignment > TLSF_ALIGN) {
+        u8 *const payload = block_payload(block);
+        uintptr_t aligned = align_forward((uintptr_t)payload, alignment);
+        if (aligned != (uintptr_t)payload && aligned - (uintptr_t)payload < gap_min) {
+            aligned = align_forward((uintptr_t)payload + gap_min, alignment);
+        }
+        const size_t gap = aligned - (uintptr_t)payload;
+        if (gap) {
+            TlsfBlock *const aligned_block = block_split(block, gap - TLSF_BLOCK_HEADER);
+            insert_free_block(tlsf, block);
+            block = aligned_block;
+        }
+    }
+
+    block_set_free(block, false);
+    block_trim_used(tlsf, block, adjusted);
+    return block_payload(block);
+}
+
+void tlsf_free(Tlsf *tlsf, void *mem) {
+    if (!mem) {
+        return;
+    }
+    TlsfBlock *block = block_from_payload(mem);
+    MY_ASSERT(!block_is_free(block) && "Double free");
+    block_set_free(block, true);
+    block = block_merge_prev(tlsf, block);
+    block = block_merge_next(tlsf, block);
+    insert_free_block(tlsf, block);
+}
+
+void* tlsf_realloc(Tlsf *tlsf, void *mem, size_t new_size, size_t alignment) {
+    if (!mem) {
+        return tlsf_alloc(tlsf, new_size, alignment);
+    }
+    if (!new_size) {
+        tlsf_free(tlsf, mem);
+        return NULL;
+    }
+    TlsfBlock *const block = block_from_payload(mem);
+    const size_t cur_size = block_size(block);
+    const size_t adjusted = adjust_request_size(new_size);
+    const TlsfBlock *const next = block_next(block);
+    const size_t combined = cur_size + (block_is_free(next) ? TLSF_BLOCK_HEADER + block_size(next) : 0);
+    const bool aligned = ((uintptr_t)mem & (alignment - 1)) == 0;
+
+    if (!aligned || adjusted > combined) {
+        void *const ret_val = tlsf_alloc(tlsf, new_size, alignment);
+        if (ret_val) {
+            memcpy(ret_val, mem, cur_size < new_size ? cur_size : new_size);
+            tlsf_free(tlsf, mem);
+        }
+        return ret_val;
+    }
+    if (adjusted > cur_size) {
+        block_merge_next(tlsf, block);
+    }
+    block_trim_used(tlsf, block, adjusted);
+    return mem;
+}
+
+size_t tlsf_block_size(const void *mem) {
+    return block_size(block_from_payload(mem));
+}
+
+void tlsf_get_stats(const Tlsf *tlsf, TlsfStats *stats) {
+    *stats = (TlsfStats) { 0 };
+    const TlsfBlock *block = (const TlsfBlock*)align_forward((uintptr_t)tlsf->buf, TLSF_ALIGN);
+    for (; block_size(block); block = block_next(block)) {
+        const size_t size = block_size(block);
+        if (block_is_free(block)) {
+            stats->free_bytes += size;
+            stats->free_blocks++;
+            if (size > stats->largest_free_block) {
+                stats->largest_free_block = size;
+            }
+        } else {
+            stats->used_bytes += size;
+            stats->used_blocks++;
+        }
+    }
+}
@@ -0,0 +1,240 @@
+#include "vertex_pack.h"
+
+#include <math.h>
+#include <string.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+// F16C is not in the x86-64 baseline, without -mf16c it is picked at runtime
+#if defined(__F16C__) || ((defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__))
+#define VERTEX_PACK_F16C 1
+#include <immintrin.h>
+#endif
+
+u16 f32_to_half(f32 value) {
+    u32 bits;
+    memcpy(&bits, &value, sizeof(bits));
+    const u32 sign = (bits >> 16) & 0x8000;
+    const u32 abs = bits & 0x7fffffff;
+    if (abs >= 0x7f800000) {
+        return sign | 0x7c00 | (abs > 0x7f800000 ? 0x200 : 0);
+    }
+    // 65520 and up round past the largest half
+    if (abs >= 0x477ff000) {
+        return sign | 0x7c00;
+    }
+    // below 2^-25 everything rounds to zero
+    if (abs < 0x33000000) {
+        return sign;
+    }
+    if (abs < 0x38800000) {
+        // subnormal half: mantissa with the implicit bit, in units of 2^-24
+        const u32 mant = (abs & 0x7fffff) | 0x800000;
+        const u32 shift = 126 - (abs >> 23);
+        u32 half = mant >> shift;
+        const u32 rem = mant & ((1u << shift) - 1);
+        const u32 halfway = 1u << (shift - 1);
+        if (rem > halfway || (rem == halfway && (half & 1))) {
+            half++;
+        }
+        return sign | half;
+    }
+    // rebias the exponent, a carry out of the mantissa bumps it correctly
+    u32 half = (abs >> 13) - ((127 - 15) << 10);
+    const u32 rem = abs & 0x1fff;
+    if (rem > 0x1000 || (rem == 0x1000 && (half & 1))) {
+        half++;
+    }
+    return sign | half;
+}
+
+f32 half_to_f32(u16 half) {
+    const u32 sign = (u32)(half & 0x8000) << 16;
+    const u32 exp = (half >> 10) & 0x1f;
+    const u32 mant = half & 0x3ff;
+    u32 bits;
+    if (exp == 0x1f) {
+        bits = sign | 0x7f800000 | (mant << 13);
+    } else if (exp) {
+        bits = sign | ((exp + 127 - 15) << 23) | (mant << 13);
+    } else {
+        const f32 value = (f32)mant * 0x1p-24f;
+        memcpy(&bits, &value, sizeof(bits));
+        bits |= sign;
+    }
+    f32 value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+static i16 snorm16(f32 value) {
+    const f32 clamped = value < -1 ? -1 : (value > 1 ? 1 : value);
+    return (i16)lrintf(clamped * 32767.f);
+}
+
+void oct_encode_snorm16(const f32 n[static 3], i16 out[static 2]) {
+    const f32 l1 = fabsf(n[0]) + fabsf(n[1]) + fabsf(n[2]);
+    if (l1 == 0) {
+        out[0] = 0;
+        out[1] = 0;
+        return;
+    }
+    f32 x = n[0] / l1;
+    f32 y = n[1] / l1;
+    // fold the lower hemisphere over the diagonals
+    if (n[2] < 0) {
+        const f32 folded_x = (1 - fabsf(y)) * (x >= 0 ? 1 : -1);
+        y = (1 - fabsf(x)) * (y >= 0 ? 1 : -1);
+        x = folded_x;
+    }
+    out[0] = snorm16(x);
+    out[1] = snorm16(y);
+}
+
+void oct_decode_snorm16(const i16 in[static 2], f32 n[static 3]) {
+    f32 x = fmaxf(in[0] / 32767.f, -1);
+    f32 y = fmaxf(in[1] / 32767.f, -1);
+    const f32 z = 1 - fabsf(x) - fabsf(y);
+    if (z < 0) {
+        const f32 unfolded_x = (1 - fabsf(y)) * (x >= 0 ? 1 : -1);
+        y = (1 - fabsf(x)) * (y >= 0 ? 1 : -1);
+        x = unfolded_x;
+    }
+    const f32 len = sqrtf(x * x + y * y + z * z);
+    n[0] = x / len;
+    n[1] = y / len;
+    n[2] = z / len;
+}
+
+void vertex_bounds(const Vertex *verts, u32 cnt, f32 center[static 3], f32 extent[static 3]) {
+    f32 lo[3] = { INFINITY, INFINITY, INFINITY };
+    f32 hi[3] = { -INFINITY, -INFINITY, -INFINITY };
+    for (u32 i=0; i<cnt; i++) {
+        for (u32 axis=0; axis<3; axis++) {
+            lo[axis] = fminf(lo[axis], verts[i].coord[axis]);
+            hi[axis] = fmaxf(hi[axis], verts[i].coord[axis]);
+        }
+    }
+    for (u32 axis=0; axis<3; axis++) {
+        center[axis] = cnt ? (lo[axis] + hi[axis]) * 0.5f : 0;
+        extent[axis] = cnt ? (hi[axis] - lo[axis]) * 0.5f : 0;
+        if (extent[axis] == 0) {
+            extent[axis] = 1;
+        }
+    }
+}
+
+// coord is the first member of every bounds relative struct, stride apart
+static void pack_coords(u8 *restrict dst, size_t stride, const Vertex *restrict src, u32 cnt, const f32 center[static 3], const f32 extent[static 3]) {
+#if defined(__SSE2__)
+    // lane 3 loads texcoord[0], the zero scale drops it and the padding store overwrites it
+    const __m128 offset = _mm_setr_ps(center[0], center[1], center[2], 0);
+    const __m128 scale = _mm_setr_ps(32767.f / extent[0], 32767.f / extent[1], 32767.f / extent[2], 0);
+    for (u32 i=0; i<cnt; i++) {
+        i16 *const coord = (i16*)(dst + i * stride);
+        const __m128 scaled = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(src[i].coord), offset), scale);
+        // round to nearest, then saturate to i16
+        const __m128i quantized = _mm_cvtps_epi32(scaled);
+        _mm_storel_epi64((__m128i*)coord, _mm_packs_epi32(quantized, quantized));
+        coord[3] = 0;
+    }
+#else
+    for (u32 i=0; i<cnt; i++) {
+        i16 *const coord = (i16*)(dst + i * stride);
+        for (u32 axis=0; axis<3; axis++) {
+            coord[axis] = snorm16((src[i].coord[axis] - center[axis]) / extent[axis]);
+        }
+        coord[3] = 0;
+    }
+#endif
+}
+
+static void pack_color(const f32 src[static 3], u8 dst[static 4]) {
+    for (u32 channel=0; channel<3; channel++) {
+        const f32 color = src[channel];
+        dst[channel] = (u8)lrintf((color < 0 ? 0 : (color > 1 ? 1 : color)) * 255.f);
+    }
+    dst[3] = 255;
+}
+
+#if defined(VERTEX_PACK_F16C)
+#if !defined(__F16C__)
+__attribute__((target("f16c")))
+#endif
+static void pack_texcoords_f16c(PackedVertex *restrict dst, const Vertex *restrict src, u32 cnt) {
+    for (u32 i=0; i<cnt; i++) {
+        const __m128 texcoord = _mm_setr_ps(src[i].texcoord[0], src[i].texcoord[1], 0, 0);
+        const u32 halves = _mm_cvtsi128_si32(_mm_cvtps_ph(texcoord, _MM_FROUND_TO_NEAREST_INT));
+        memcpy(dst[i].texcoord, &halves, sizeof(halves));
+    }
+}
+#endif
+
+static void pack_texcoords_scalar(PackedVertex *restrict dst, const Vertex *restrict src, u32 cnt) {
+    for (u32 i=0; i<cnt; i++) {
+        dst[i].texcoord[0] = f32_to_half(src[i].texcoord[0]);
+        dst[i].texcoord[1] = f32_to_half(src[i].texcoord[1]);
+    }
+}
+
+bool vertex_pack_has_f16c(void) {
+#if defined(__F16C__)
+    return true;
+#elif defined(VERTEX_PACK_F16C)
+    return __builtin_cpu_supports("f16c");
+#else
+    return false;
+#endif
+}
+
+void vertex_pack(void *restrict dst_buf, const Vertex *restrict src, u32 cnt, const f32 center[static 3], const f32 extent[static 3]) {
+    PackedVertex *const dst = dst_buf;
+    pack_coords(dst_buf, sizeof(PackedVertex), src, cnt, center, extent);
+#if defined(VERTEX_PACK_F16C)
+    if (vertex_pack_has_f16c()) {
+        pack_texcoords_f16c(dst, src, cnt);
+    } else {
+        pack_texcoords_scalar(dst, src, cnt);
+    }
+#else
+    pack_texcoords_scalar(dst, src, cnt);
+#endif
+    for (u32 i=0; i<cnt; i++) {
+        oct_encode_snorm16(src[i].normal, dst[i].normal);
+        pack_color(src[i].color, dst[i].color);
+    }
+}
+
+void vertex_pack_colored(void *restrict dst_buf, const Vertex *restrict src, u32 cnt, const f32 center[static 3], const f32 extent[static 3]) {
+    ColoredVertex *const dst = dst_buf;
+    pack_coords(dst_buf, sizeof(ColoredVertex), src, cnt, center, extent);
+    for (u32 i=0; i<cnt; i++) {
+        pack_color(src[i].color, dst[i].color);
+    }
+}
+
+void index_narrow_u16(u16 *restrict dst, const u32 *restrict src, u32 cnt) {
+    // checked up front for both paths, the loop goes away with the assert
+    u32 max_index = 0;
+    for (u32 j=0; j<cnt; j++) {
+        max_index = src[j] > max_index ? src[j] : max_index;
+    }
+    MY_ASSERT(max_index <= UINT16_MAX);
+    UNUSED(max_index);
+    u32 i = 0;
+#if defined(__SSE2__)
+    // SSE2 only packs with signed saturation, shift into the i16 range and back
+    const __m128i bias32 = _mm_set1_epi32(0x8000);
+    const __m128i bias16 = _mm_set1_epi16(INT16_MIN);
+    for (; i+8<=cnt; i+=8) {
+        const __m128i lo = _mm_sub_epi32(_mm_loadu_si128((const __m128i*)&src[i]), bias32);
+        const __m128i hi = _mm_sub_epi32(_mm_loadu_si128((const __m128i*)&src[i + 4]), bias32);
+        _mm_storeu_si128((__m128i*)&dst[i], _mm_xor_si128(_mm_packs_epi32(lo, hi), bias16));
+    }
+#endif
+    // saturates like the SSE2 path
+    for (; i<cnt; i++) {
+        dst[i] = src[i] > UINT16_MAX ? UINT16_MAX : (u16)src[i];
+    }
+}
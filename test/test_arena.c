@@ -0,0 +1,86 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "common.h"
+#include "arena.h"
+
+// Checks that temps and in place realloc do not hand out the same memory
+// twice. Exits non-zero on the first mismatch.
+
+#define CHECK(cond) do { \
+    if (!(cond)) { \
+        fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+        return false; \
+    } \
+} while (0)
+
+static bool overlap(const u8 *a, size_t a_size, const u8 *b, size_t b_size) {
+    return a < b + b_size && b < a + a_size;
+}
+
+static bool test_realloc_in_temp(Arena *arena) {
+    arena_clear(arena);
+    u8 *const block = arena_alloc(arena, 64, 16);
+    CHECK(block);
+    memset(block, 0xab, 64);
+    ArenaTemp temp = arena_temp_begin(arena);
+    u8 *const grown = arena_realloc(arena, block, 64, 128, 16);
+    CHECK(grown);
+    // growing in place would outlive the temp
+    CHECK(grown != block);
+    arena_temp_end(temp);
+    u8 *const next = arena_alloc(arena, 64, 16);
+    CHECK(next);
+    CHECK(!overlap(block, 64, next, 64));
+    memset(next, 0xcd, 64);
+    for (u32 i=0; i<64; i++) {
+        CHECK(block[i] == 0xab);
+    }
+    return true;
+}
+
+static bool test_realloc_in_place(Arena *arena) {
+    arena_clear(arena);
+    u8 *const block = arena_alloc(arena, 64, 16);
+    CHECK(block);
+    CHECK(arena_realloc(arena, block, 64, 128, 16) == block);
+    // a temp that allocated nothing gives the last block back
+    ArenaTemp temp = arena_temp_begin(arena);
+    arena_temp_end(temp);
+    CHECK(arena_realloc(arena, block, 128, 256, 16) == block);
+    u8 *const next = arena_alloc(arena, 64, 16);
+    CHECK(next);
+    CHECK(!overlap(block, 256, next, 64));
+    return true;
+}
+
+static bool test_nested_temps(Arena *arena) {
+    arena_clear(arena);
+    ArenaTemp outer = arena_temp_begin(arena);
+    u8 *const a = arena_alloc(arena, 32, 16);
+    ArenaTemp inner = arena_temp_begin(arena);
+    u8 *const b = arena_alloc(arena, 32, 16);
+    CHECK(a && b);
+    CHECK(!overlap(a, 32, b, 32));
+    CHECK(arena_realloc(arena, b, 32, 64, 16) == b);
+    arena_temp_end(inner);
+    u8 *const c = arena_alloc(arena, 32, 16);
+    CHECK(c == b);
+    arena_temp_end(outer);
+    CHECK(arena->offset == 0);
+    return true;
+}
+
+int main(int argc, char **argv) {
+    UNUSED(argc);
+    UNUSED(argv);
+    Arena arena;
+    if (!arena_init_virtual(&arena, 64 * 1024 * 1024, ARENA_FLAG_NONE)) {
+        fprintf(stderr, "arena reserve failed\n");
+        return 1;
+    }
+    const bool ok = test_realloc_in_temp(&arena) && test_realloc_in_place(&arena) && test_nested_temps(&arena);
+    arena_release(&arena);
+    printf("arena: %s\n", ok ? "ok" : "FAILED");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,185 @@
+#include <pthread.h>
+#include <stdio.h>
+
+#include "common.h"
+#include "arena.h"
+#include "concurrent_pool.h"
+
+// Threads allocate, tag every word of their elements with their id and the
+// round, check the tags after a barrier and free into their neighbour's
+// cache, so batches cross threads all the time. A second pass churns without
+// barriers so pops race pushes. Meant to run under
+// -fsanitize=thread as well, which is why it uses pthreads: TSan does not
+// intercept the C11 thread functions. Exits non-zero on the first mismatch.
+
+enum { THREAD_CNT = 8 };
+enum { ELEM_SIZE = 64 };
+enum { ELEM_ALIGN = 16 };
+enum { ROUND_ELEMS = 256 };
+enum { ROUNDS = 2000 };
+
+typedef struct StressShared {
+    ConcurrentPool pool;
+    pthread_barrier_t barrier;
+    u64 *handoff[THREAD_CNT][ROUND_ELEMS];
+    _Atomic u32 failures;
+} StressShared;
+
+typedef struct StressJob {
+    StressShared *shared;
+    u32 id;
+} StressJob;
+
+static void* stress_thread(void *arg) {
+    StressJob *const job = arg;
+    StressShared *const shared = job->shared;
+    ConcurrentPoolCache cache;
+    concurrent_pool_cache_init(&cache, &shared->pool);
+    for (u32 r=0; r<ROUNDS; r++) {
+        const u64 tag = ((u64)job->id << 32) | r;
+        for (u32 i=0; i<ROUND_ELEMS; i++) {
+            u64 *const elem = concurrent_pool_cache_alloc(&cache);
+            if (!elem) {
+                atomic_fetch_add(&shared->failures, 1);
+                shared->handoff[job->id][i] = NULL;
+                continue;
+            }
+            for (u32 w=0; w<ELEM_SIZE / sizeof(u64); w++) {
+                elem[w] = tag;
+            }
+            shared->handoff[job->id][i] = elem;
+        }
+        pthread_barrier_wait(&shared->barrier);
+        // an element handed out twice would have been overwritten by its second owner
+        for (u32 i=0; i<ROUND_ELEMS; i++) {
+            u64 *const elem = shared->handoff[job->id][i];
+            if (!elem) {
+                continue;
+            }
+            for (u32 w=0; w<ELEM_SIZE / sizeof(u64); w++) {
+                if (elem[w] != tag) {
+                    atomic_fetch_add(&shared->failures, 1);
+                    break;
+                }
+            }
+        }
+        pthread_barrier_wait(&shared->barrier);
+        const u32 neighbour = (job->id + 1) % THREAD_CNT;
+        for (u32 i=0; i<ROUND_ELEMS; i++) {
+            if (shared->handoff[neighbour][i]) {
+                concurrent_pool_cache_free(&cache, shared->handoff[neighbour][i]);
+            }
+        }
+        pthread_barrier_wait(&shared->barrier);
+    }
+    concurrent_pool_cache_flush(&cache);
+    return NULL;
+}
+
+static bool test_stress(Arena *arena) {
+    static StressShared shared;
+    concurrent_pool_init(&shared.pool, (AllocatorPoly)ARENA_POLY(arena), ELEM_SIZE, ELEM_ALIGN, 4);
+    pthread_barrier_init(&shared.barrier, NULL, THREAD_CNT);
+    atomic_init(&shared.failures, 0);
+    pthread_t threads[THREAD_CNT];
+    StressJob jobs[THREAD_CNT];
+    for (u32 t=0; t<THREAD_CNT; t++) {
+        jobs[t] = (StressJob) { .shared = &shared, .id = t };
+        if (pthread_create(&threads[t], NULL, stress_thread, &jobs[t])) {
+            fprintf(stderr, "pthread_create failed\n");
+            return false;
+        }
+    }
+    for (u32 t=0; t<THREAD_CNT; t++) {
+        pthread_join(threads[t], NULL);
+    }
+    pthread_barrier_destroy(&shared.barrier);
+    const u32 failures = atomic_load(&shared.failures);
+    if (failures) {
+        fprintf(stderr, "%u elements were lost or handed out twice\n", failures);
+        return false;
+    }
+    return true;
+}
+
+enum { CHURN_OPS = 200000 };
+// fewer than two batches, every cache keeps going to the shared stack
+enum { CHURN_HELD = CONCURRENT_POOL_BATCH_SIZE + CONCURRENT_POOL_BATCH_SIZE / 2 };
+
+typedef struct ChurnJob {
+    ConcurrentPool *pool;
+    u32 id;
+    u32 failures;
+} ChurnJob;
+
+// no barriers, pops race pushes and refills on the shared stack
+static void* churn_thread(void *arg) {
+    ChurnJob *const job = arg;
+    ConcurrentPoolCache cache;
+    concurrent_pool_cache_init(&cache, job->pool);
+    u64 *held[CHURN_HELD] = { 0 };
+    for (u32 op=0; op<CHURN_OPS; op++) {
+        const u32 slot = op % CHURN_HELD;
+        const u64 tag = ((u64)job->id << 32) | op;
+        if (held[slot]) {
+            const u64 held_tag = ((u64)job->id << 32) | (op - CHURN_HELD);
+            for (u32 w=0; w<ELEM_SIZE / sizeof(u64); w++) {
+                job->failures += held[slot][w] != held_tag;
+            }
+            concurrent_pool_cache_free(&cache, held[slot]);
+        }
+        held[slot] = concurrent_pool_cache_alloc(&cache);
+        if (!held[slot]) {
+            job->failures++;
+            continue;
+        }
+        for (u32 w=0; w<ELEM_SIZE / sizeof(u64); w++) {
+            held[slot][w] = tag;
+        }
+    }
+    for (u32 slot=0; slot<CHURN_HELD; slot++) {
+        if (held[slot]) {
+            concurrent_pool_cache_free(&cache, held[slot]);
+        }
+    }
+    concurrent_pool_cache_flush(&cache);
+    return NULL;
+}
+
+static bool test_churn(Arena *arena) {
+    ConcurrentPool pool;
+    concurrent_pool_init(&pool, (AllocatorPoly)ARENA_POLY(arena), ELEM_SIZE, ELEM_ALIGN, 1);
+    pthread_t threads[THREAD_CNT];
+    ChurnJob jobs[THREAD_CNT];
+    for (u32 t=0; t<THREAD_CNT; t++) {
+        jobs[t] = (ChurnJob) { .pool = &pool, .id = t };
+        if (pthread_create(&threads[t], NULL, churn_thread, &jobs[t])) {
+            fprintf(stderr, "pthread_create failed\n");
+            return false;
+        }
+    }
+    u32 failures = 0;
+    for (u32 t=0; t<THREAD_CNT; t++) {
+        pthread_join(threads[t], NULL);
+        failures += jobs[t].failures;
+    }
+    if (failures) {
+        fprintf(stderr, "churn: %u elements were lost or handed out twice\n", failures);
+        return false;
+    }
+    return true;
+}
+
+int main(int argc, char **argv) {
+    UNUSED(argc);
+    UNUSED(argv);
+    Arena arena;
+    if (!arena_init_virtual(&arena, (size_t)1 << 30, ARENA_FLAG_NONE)) {
+        fprintf(stderr, "arena reserve failed\n");
+        return 1;
+    }
+    const bool ok = test_stress(&arena) && test_churn(&arena);
+    arena_release(&arena);
+    printf("concurrent_pool: %s\n", ok ? "ok" : "FAILED");
+    return ok ? 0 : 1;
+}
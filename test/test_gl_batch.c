@@ -0,0 +1,287 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <SDL3/SDL.h>
+
+#include "common.h"
+#include "arena.h"
+#include "gl.h"
+
+// Checks the vertex layout comparison gl_init dedups pools with, then draws
+// one batch of three meshes, two with 16-bit indices and one with 32-bit,
+// through glMultiDrawElementsIndirect and through the per-mesh fallback and
+// reads back one pixel per instance from an offscreen target. Exits with
+// SKIP_CODE when no GL context can be created, non-zero on the first
+// mismatch.
+
+enum { SKIP_CODE = 77 };
+enum { CELL_SIZE = 16 };
+enum { INSTANCE_CNT = 6 };
+enum { MESH_CNT = 3 };
+// more vertices than 16-bit indices reach, the mesh gets GL_UNSIGNED_INT
+enum { WIDE_VERT_CNT = 65536 + 4 };
+
+static const char *const vert_src =
+    "#version 330 core\n"
+    "layout (location = 0) in vec4 aPos;\n"
+    "layout (location = 3) in vec3 aColor;\n"
+    "layout (location = 4) in uint aInstanceId;\n"
+    "uniform samplerBuffer instances;\n"
+    "out vec3 color;\n"
+    "void main() {\n"
+    "    int base = int(aInstanceId) * 5;\n"
+    "    mat4 model = mat4(texelFetch(instances, base), texelFetch(instances, base + 1),\n"
+    "                      texelFetch(instances, base + 2), texelFetch(instances, base + 3));\n"
+    "    color = aColor * texelFetch(instances, base + 4).rgb;\n"
+    "    gl_Position = model * vec4(aPos.xyz, 1);\n"
+    "}\n";
+
+static const char *const frag_src =
+    "#version 330 core\n"
+    "in vec3 color;\n"
+    "out vec4 FragColor;\n"
+    "void main() {\n"
+    "    FragColor = vec4(color, 1);\n"
+    "}\n";
+
+static const f32 mesh_colors[MESH_CNT][3] = {
+    { 1, 0, 0 },
+    { 0, 1, 0 },
+    { 0, 0, 1 },
+};
+// interleaved so the submit has to group them
+static const u32 instance_meshes[INSTANCE_CNT] = { 0, 2, 1, 0, 2, 1 };
+static const f32 instance_shades[INSTANCE_CNT] = { 1, 0.5f, 1, 0.5f, 1, 0.5f };
+
+#define CHECK(cond) do { \
+    if (!(cond)) { \
+        fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+        return false; \
+    } \
+} while (0)
+
+// no GL needed, the layouts are static tables
+static bool test_vertex_layouts_equal(void) {
+    for (u32 a=0; a<GL_VERTEX_FORMAT_COUNT; a++) {
+        for (u32 b=0; b<GL_VERTEX_FORMAT_COUNT; b++) {
+            CHECK(gl_vertex_layouts_equal(gl_vertex_layout(a), gl_vertex_layout(b)) == (a == b));
+        }
+    }
+    // a format that only differs in its encoder and bounds shares the pool
+    const GlVertexLayout *const colored = gl_vertex_layout(GL_VERTEX_FORMAT_COLORED);
+    GlVertexLayout alias = *colored;
+    alias.name = "COLORED_ALIAS";
+    alias.encode = NULL;
+    alias.bounds_relative = false;
+    CHECK(gl_vertex_layouts_equal(colored, &alias));
+    // one attribute moved is a different VAO
+    GlVertexAttrib attribs[8];
+    CHECK(colored->attrib_cnt <= ARRAY_LEN(attribs));
+    memcpy(attribs, colored->attribs, sizeof(*attribs) * colored->attrib_cnt);
+    attribs[colored->attrib_cnt - 1].offset++;
+    alias.attribs = attribs;
+    CHECK(!gl_vertex_layouts_equal(colored, &alias));
+    return true;
+}
+
+static GLuint compile_program(void) {
+    const char *const srcs[] = { vert_src, frag_src };
+    const GLenum types[] = { GL_VERTEX_SHADER, GL_FRAGMENT_SHADER };
+    const GLuint prog = glCreateProgram();
+    for (u32 i=0; i<ARRAY_LEN(srcs); i++) {
+        const GLuint shader = glCreateShader(types[i]);
+        glShaderSource(shader, 1, &srcs[i], NULL);
+        glCompileShader(shader);
+        glAttachShader(prog, shader);
+        glDeleteShader(shader);
+    }
+    glLinkProgram(prog);
+    GLint linked;
+    glGetProgramiv(prog, GL_LINK_STATUS, &linked);
+    if (!linked) {
+        glDeleteProgram(prog);
+        return 0;
+    }
+    return prog;
+}
+
+// a quad over [-1, 1] in the first and last four vertices, the ones between
+// only make the mesh large
+static void fill_quad(Vertex *verts, u32 vert_cnt, GLuint indices[static 6], const f32 color[static 3]) {
+    static const f32 corners[4][2] = { { -1, -1 }, { 1, -1 }, { 1, 1 }, { -1, 1 } };
+    const u32 first = vert_cnt - 4;
+    for (u32 i=0; i<vert_cnt; i++) {
+        const f32 *const corner = corners[i % 4];
+        verts[i] = (Vertex) {
+            .coord = { corner[0], corner[1], 0 },
+            .color = { color[0], color[1], color[2] },
+        };
+    }
+    const GLuint quad[] = { 0, 1, 2, 0, 2, 3 };
+    for (u32 i=0; i<ARRAY_LEN(quad); i++) {
+        indices[i] = first + quad[i];
+    }
+}
+
+static bool test_draw(Arena *frame_arena, const MeshHandle handles[static MESH_CNT], GLuint fbo, bool multi_draw_indirect) {
+    f32 transforms[INSTANCE_CNT][16];
+    f32 tints[INSTANCE_CNT][4];
+    GlBatch batch;
+    gl_batch_begin(&batch, frame_arena);
+    batch.format = GL_VERTEX_FORMAT_VERTEX;
+    CHECK(gl_batch_reserve(&batch, INSTANCE_CNT));
+    for (u32 i=0; i<INSTANCE_CNT; i++) {
+        // column major, each instance covers the middle of its cell
+        const f32 cell_ndc = 2.0f / INSTANCE_CNT;
+        memset(transforms[i], 0, sizeof(transforms[i]));
+        transforms[i][0] = cell_ndc * 0.25f;
+        transforms[i][5] = 0.5f;
+        transforms[i][10] = 1;
+        transforms[i][12] = -1 + cell_ndc * (i + 0.5f);
+        transforms[i][15] = 1;
+        const f32 shade = instance_shades[i];
+        tints[i][0] = shade;
+        tints[i][1] = shade;
+        tints[i][2] = shade;
+        tints[i][3] = 1;
+        CHECK(gl_batch_add(&batch, handles[instance_meshes[i]], transforms[i], tints[i]));
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+    gl_set_viewport(0, 0, CELL_SIZE * INSTANCE_CNT, CELL_SIZE);
+    glClearColor(0, 0, 0, 1);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    gl_frame_begin();
+    CHECK(gl_batch_submit(&batch) == MESH_CNT);
+    gl_frame_end();
+    u8 pixels[INSTANCE_CNT][4];
+    for (u32 i=0; i<INSTANCE_CNT; i++) {
+        glReadPixels(CELL_SIZE * i + CELL_SIZE / 2, CELL_SIZE / 2, 1, 1, GL_RGBA, GL_UNSIGNED_BYTE, pixels[i]);
+    }
+    CHECK(glGetError() == GL_NO_ERROR);
+    for (u32 i=0; i<INSTANCE_CNT; i++) {
+        const f32 *const color = mesh_colors[instance_meshes[i]];
+        for (u32 c=0; c<3; c++) {
+            const int expected = (int)(color[c] * instance_shades[i] * 255 + 0.5f);
+            if (abs(pixels[i][c] - expected) > 2) {
+                fprintf(stderr, "%s: instance %u channel %u is %u, expected %d\n",
+                        multi_draw_indirect ? "mdi" : "fallback", i, c, pixels[i][c], expected);
+                return false;
+            }
+        }
+    }
+    arena_clear(frame_arena);
+    return true;
+}
+
+static bool test_gl_batch(Arena *persist_arena, Arena *frame_arena) {
+    CHECK(gl_init((AllocatorPoly)ARENA_POLY(persist_arena), MESH_CNT) == GL_ERROR_NONE);
+    for (u32 a=0; a<GL_VERTEX_FORMAT_COUNT; a++) {
+        for (u32 b=0; b<GL_VERTEX_FORMAT_COUNT; b++) {
+            CHECK(gl_vertex_formats_share_pool(a, b) == gl_vertex_layouts_equal(gl_vertex_layout(a), gl_vertex_layout(b)));
+        }
+    }
+    const GLuint prog = compile_program();
+    CHECK(prog);
+    gl_use_program(prog);
+    glUniform1i(glGetUniformLocation(prog, "instances"), GL_INSTANCES_TEXTURE_UNIT);
+
+    static Vertex wide_verts[WIDE_VERT_CNT];
+    Vertex narrow_verts[2][4];
+    GLuint indices[MESH_CNT][6];
+    fill_quad(narrow_verts[0], 4, indices[0], mesh_colors[0]);
+    fill_quad(narrow_verts[1], 4, indices[1], mesh_colors[1]);
+    fill_quad(wide_verts, WIDE_VERT_CNT, indices[2], mesh_colors[2]);
+    MeshHandle handles[MESH_CNT];
+    Vertex *verts_arr[] = { narrow_verts[0], narrow_verts[1], wide_verts };
+    GLuint *indices_arr[] = { indices[0], indices[1], indices[2] };
+    u32 vert_cnts[] = { 4, 4, WIDE_VERT_CNT };
+    u32 indices_cnts[] = { 6, 6, 6 };
+    const GlVertexFormat formats[] = { GL_VERTEX_FORMAT_VERTEX, GL_VERTEX_FORMAT_VERTEX, GL_VERTEX_FORMAT_VERTEX };
+    CHECK(gl_mesh_init(MESH_CNT, handles, verts_arr, indices_arr, vert_cnts, indices_cnts, formats) == GL_ERROR_NONE);
+    CHECK(gl_mesh_get_data(handles[0])->index_type == GL_UNSIGNED_SHORT);
+    CHECK(gl_mesh_get_data(handles[2])->index_type == GL_UNSIGNED_INT);
+
+    GLuint fbo;
+    GLuint renderbuffers[2];
+    glGenFramebuffers(1, &fbo);
+    glGenRenderbuffers(ARRAY_LEN(renderbuffers), renderbuffers);
+    glBindRenderbuffer(GL_RENDERBUFFER, renderbuffers[0]);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, CELL_SIZE * INSTANCE_CNT, CELL_SIZE);
+    glBindRenderbuffer(GL_RENDERBUFFER, renderbuffers[1]);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, CELL_SIZE * INSTANCE_CNT, CELL_SIZE);
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, renderbuffers[0]);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, renderbuffers[1]);
+    CHECK(glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE);
+
+    bool ok = true;
+    if (gl_set_multi_draw_indirect(true)) {
+        ok = test_draw(frame_arena, handles, fbo, true);
+    } else {
+        printf("gl_batch: no multi draw indirect, only the fallback is checked\n");
+    }
+    CHECK(gl_set_multi_draw_indirect(false));
+    ok = ok && test_draw(frame_arena, handles, fbo, false);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glDeleteFramebuffers(1, &fbo);
+    glDeleteRenderbuffers(ARRAY_LEN(renderbuffers), renderbuffers);
+    gl_use_program(0);
+    glDeleteProgram(prog);
+    gl_mesh_destroy(MESH_CNT, handles);
+    gl_deinit();
+    return ok;
+}
+
+int main(int argc, char **argv) {
+    UNUSED(argc);
+    UNUSED(argv);
+    if (!test_vertex_layouts_equal()) {
+        printf("gl_batch: FAILED\n");
+        return 1;
+    }
+    if (!SDL_Init(SDL_INIT_VIDEO)) {
+        printf("gl_batch: skipped, %s\n", SDL_GetError());
+        return SKIP_CODE;
+    }
+    SDL_GL_SetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, 3);
+    SDL_GL_SetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, 3);
+    SDL_GL_SetAttribute(SDL_GL_CONTEXT_PROFILE_MASK, SDL_GL_CONTEXT_PROFILE_CORE);
+    SDL_Window *const win = SDL_CreateWindow("test_gl_batch", CELL_SIZE, CELL_SIZE, SDL_WINDOW_OPENGL | SDL_WINDOW_HIDDEN);
+    SDL_GLContext gl_ctx = win ? SDL_GL_CreateContext(win) : NULL;
+    glewExperimental = true;
+    if (!gl_ctx || glewInit() != GLEW_OK) {
+        printf("gl_batch: skipped, no GL context: %s\n", SDL_GetError());
+        if (gl_ctx) {
+            SDL_GL_DestroyContext(gl_ctx);
+        }
+        if (win) {
+            SDL_DestroyWindow(win);
+        }
+        SDL_Quit();
+        return SKIP_CODE;
+    }
+    // glewInit leaves GL_INVALID_ENUM behind on core profiles
+    while (glGetError() != GL_NO_ERROR) {
+    }
+    Arena persist_arena;
+    Arena frame_arena;
+    bool ok = false;
+    if (arena_init_virtual(&persist_arena, 64 * 1024 * 1024, ARENA_FLAG_NONE)) {
+        if (arena_init_virtual(&frame_arena, 16 * 1024 * 1024, ARENA_FLAG_NONE)) {
+            ok = test_gl_batch(&persist_arena, &frame_arena);
+            arena_release(&frame_arena);
+        } else {
+            fprintf(stderr, "arena reserve failed\n");
+        }
+        arena_release(&persist_arena);
+    } else {
+        fprintf(stderr, "arena reserve failed\n");
+    }
+    SDL_GL_DestroyContext(gl_ctx);
+    SDL_DestroyWindow(win);
+    SDL_Quit();
+    printf("gl_batch: %s\n", ok ? "ok" : "FAILED");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,100 @@
+#include <stdio.h>
+
+#include "common.h"
+#include "arena.h"
+#include "hash_map.h"
+
+// Checks the Robin Hood map against a flat reference array through growth,
+// overwrites and backward shift removal. Exits non-zero on the first mismatch.
+
+enum { KEY_RANGE = 4096 };
+enum { OP_CNT = 200000 };
+
+HASH_MAP_DEFINE(U32Map, u32_map, u32, u32, hash_u32, eq_u32)
+HASH_MAP_DEFINE(NameMap, name_map, StringView, u32, hash_sv, eq_sv)
+
+static u32 xorshift32(u32 *state) {
+    u32 x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return *state = x;
+}
+
+#define CHECK(cond) do { \
+    if (!(cond)) { \
+        fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+        return false; \
+    } \
+} while (0)
+
+static bool test_u32_map(Arena *arena) {
+    U32Map map;
+    u32_map_init(&map, (AllocatorPoly)ARENA_POLY(arena));
+    static bool present[KEY_RANGE];
+    static u32 values[KEY_RANGE];
+    u32 size = 0;
+    u32 rng = 0x9e3779b9;
+    for (u32 op=0; op<OP_CNT; op++) {
+        const u32 key = xorshift32(&rng) % KEY_RANGE;
+        const u32 kind = xorshift32(&rng) % 3;
+        if (kind == 0) {
+            CHECK(u32_map_put(&map, key, op));
+            size += !present[key];
+            present[key] = true;
+            values[key] = op;
+        } else if (kind == 1) {
+            CHECK(u32_map_remove(&map, key) == present[key]);
+            size -= present[key];
+            present[key] = false;
+        } else {
+            const u32 *const val = u32_map_get(&map, key);
+            CHECK(!val == !present[key]);
+            CHECK(!val || *val == values[key]);
+        }
+        CHECK(map.size == size);
+    }
+    for (u32 key=0; key<KEY_RANGE; key++) {
+        const u32 *const val = u32_map_get(&map, key);
+        CHECK(!val == !present[key]);
+        CHECK(!val || *val == values[key]);
+    }
+    u32_map_clear(&map);
+    CHECK(map.size == 0);
+    CHECK(!u32_map_get(&map, 0));
+    return true;
+}
+
+static bool test_name_map(Arena *arena) {
+    NameMap map;
+    name_map_init(&map, (AllocatorPoly)ARENA_POLY(arena));
+    static char names[KEY_RANGE][16];
+    for (u32 i=0; i<KEY_RANGE; i++) {
+        const int len = snprintf(names[i], sizeof(names[i]), "u_name_%u", i);
+        CHECK(name_map_put(&map, (StringView) { .data = names[i], .size = len }, i));
+    }
+    CHECK(map.size == KEY_RANGE);
+    for (u32 i=0; i<KEY_RANGE; i++) {
+        // a separate copy, keys compare by content
+        char copy[16];
+        const int len = snprintf(copy, sizeof(copy), "u_name_%u", i);
+        const u32 *const val = name_map_get(&map, (StringView) { .data = copy, .size = len });
+        CHECK(val && *val == i);
+    }
+    CHECK(!name_map_get(&map, (StringView) { .data = "u_name_", .size = 7 }));
+    return true;
+}
+
+int main(int argc, char **argv) {
+    UNUSED(argc);
+    UNUSED(argv);
+    Arena arena;
+    if (!arena_init_virtual(&arena, 256 * 1024 * 1024, ARENA_FLAG_NONE)) {
+        fprintf(stderr, "arena reserve failed\n");
+        return 1;
+    }
+    const bool ok = test_u32_map(&arena) && test_name_map(&arena);
+    arena_release(&arena);
+    printf("hash_map: %s\n", ok ? "ok" : "FAILED");
+    return ok ? 0 : 1;
+}
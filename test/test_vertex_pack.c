@@ -0,0 +1,116 @@
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "common.h"
+#include "vertex_pack.h"
+
+// Round trips vertex_pack against the decoders the shader mirrors:
+// oct_decode_snorm16 for normals and half_to_f32 for texcoords. Texcoords
+// must match f32_to_half bit for bit, so the F16C path is checked against
+// the scalar one. Exits non-zero on the first mismatch.
+
+enum { VERT_CNT = 4096 };
+
+static u32 xorshift32(u32 *state) {
+    u32 x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return *state = x;
+}
+
+static f32 random_f32(u32 *state, f32 lo, f32 hi) {
+    return lo + (hi - lo) * (f32)(xorshift32(state) >> 8) * 0x1p-24f;
+}
+
+#define CHECK(cond) do { \
+    if (!(cond)) { \
+        fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+        return false; \
+    } \
+} while (0)
+
+static bool test_half(void) {
+    for (u32 half=0; half<=UINT16_MAX; half++) {
+        const f32 value = half_to_f32(half);
+        if (isnan(value)) {
+            CHECK(isnan(half_to_f32(f32_to_half(value))));
+        } else {
+            CHECK(f32_to_half(value) == half);
+        }
+    }
+    return true;
+}
+
+static bool test_pack(void) {
+    static Vertex verts[VERT_CNT];
+    static PackedVertex packed[VERT_CNT];
+    u32 rng = 0x2545f491;
+    for (u32 i=0; i<VERT_CNT; i++) {
+        Vertex *const v = &verts[i];
+        for (u32 k=0; k<3; k++) {
+            v->coord[k] = random_f32(&rng, -50, 50) * (k + 1);
+            v->color[k] = random_f32(&rng, 0, 1);
+        }
+        // texcoords past 1 and halfway cases exercise the rounding
+        v->texcoord[0] = random_f32(&rng, -4, 4);
+        v->texcoord[1] = i % 7 ? random_f32(&rng, 0, 1) : 1 + (i % 1024) * 0x1p-11f;
+        f32 n[3] = { random_f32(&rng, -1, 1), random_f32(&rng, -1, 1), random_f32(&rng, -1, 1) };
+        const f32 len = sqrtf(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+        for (u32 k=0; k<3; k++) {
+            v->normal[k] = len > 0 ? n[k] / len : (k == 2);
+        }
+    }
+    f32 center[3], extent[3];
+    vertex_bounds(verts, VERT_CNT, center, extent);
+    vertex_pack(packed, verts, VERT_CNT, center, extent);
+    f32 max_normal_err = 0;
+    for (u32 i=0; i<VERT_CNT; i++) {
+        const Vertex *const v = &verts[i];
+        const PackedVertex *const p = &packed[i];
+        CHECK(p->coord[3] == 0);
+        for (u32 k=0; k<3; k++) {
+            const f32 coord = p->coord[k] / 32767.f * extent[k] + center[k];
+            CHECK(fabsf(coord - v->coord[k]) <= extent[k] / 32767.f);
+            CHECK(fabsf(p->color[k] / 255.f - v->color[k]) <= 0.5f / 255.f + 1e-6f);
+        }
+        CHECK(p->color[3] == 255);
+        for (u32 k=0; k<2; k++) {
+            CHECK(p->texcoord[k] == f32_to_half(v->texcoord[k]));
+        }
+        f32 n[3];
+        oct_decode_snorm16(p->normal, n);
+        for (u32 k=0; k<3; k++) {
+            max_normal_err = fmaxf(max_normal_err, fabsf(n[k] - v->normal[k]));
+        }
+    }
+    printf("vertex_pack: f16c %s, max normal error %g\n", vertex_pack_has_f16c() ? "yes" : "no", max_normal_err);
+    CHECK(max_normal_err < 1e-3f);
+    return true;
+}
+
+static bool test_narrow(void) {
+    static u32 src[VERT_CNT + 5];
+    static u16 dst[VERT_CNT + 5];
+    for (u32 i=0; i<ARRAY_LEN(src); i++) {
+        src[i] = (i * 2654435761u) & UINT16_MAX;
+    }
+    src[0] = 0;
+    src[1] = INT16_MAX;
+    src[2] = INT16_MAX + 1;
+    src[ARRAY_LEN(src) - 1] = UINT16_MAX;
+    index_narrow_u16(dst, src, ARRAY_LEN(src));
+    for (u32 i=0; i<ARRAY_LEN(src); i++) {
+        CHECK(dst[i] == src[i]);
+    }
+    return true;
+}
+
+int main(int argc, char **argv) {
+    UNUSED(argc);
+    UNUSED(argv);
+    const bool ok = test_half() && test_pack() && test_narrow();
+    printf("vertex_pack: %s\n", ok ? "ok" : "FAILED");
+    return ok ? 0 : 1;
+}